@@ -2355,6 +2355,67 @@ class Board {
      * @return
      */
     [[nodiscard]] U64 hash() const noexcept { return key_; }
+
+    /**
+     * @brief Get the zobrist hash key the board would have after makeMove(move),
+     * without making the move. Mirrors makeMove<false>, so the enpassant square is
+     * hashed whenever an enemy pawn attacks it. Useful to prefetch hash table entries.
+     * @param move
+     * @return
+     */
+    [[nodiscard]] U64 keyAfter(const Move move) const noexcept {
+        U64 key = key_ ^ Zobrist::sideToMove();
+
+        if (ep_sq_ != Square::NO_SQ) key ^= Zobrist::enpassant(ep_sq_.file());
+
+        const auto piece = at(move.from());
+        const auto pt    = piece.type();
+        auto cr          = cr_;
+
+        if (move.typeOf() == Move::CASTLING) {
+            const bool king_side = move.to() > move.from();
+            const auto rook      = at(move.to());
+
+            key ^= Zobrist::piece(piece, move.from()) ^
+                   Zobrist::piece(piece, Square::castling_king_square(king_side, stm_));
+            key ^= Zobrist::piece(rook, move.to()) ^ Zobrist::piece(rook, Square::castling_rook_square(king_side, stm_));
+        } else {
+            const auto captured = at(move.to());
+
+            if (captured != Piece::NONE) {
+                key ^= Zobrist::piece(captured, move.to());
+
+                if (captured.type() == PieceType::ROOK && Rank::back_rank(move.to().rank(), ~stm_)) {
+                    const auto file = CastlingRights::closestSide(move.to(), kingSq(~stm_));
+                    if (cr.getRookFile(~stm_, file) == move.to().file()) cr.clear(~stm_, file);
+                }
+            }
+
+            if (move.typeOf() == Move::PROMOTION) {
+                key ^= Zobrist::piece(piece, move.from()) ^
+                       Zobrist::piece(Piece(move.promotionType(), stm_), move.to());
+            } else {
+                key ^= Zobrist::piece(piece, move.from()) ^ Zobrist::piece(piece, move.to());
+            }
+
+            if (move.typeOf() == Move::ENPASSANT) {
+                key ^= Zobrist::piece(Piece(PieceType::PAWN, ~stm_), move.to().ep_square());
+            } else if (pt == PieceType::PAWN && Square::value_distance(move.to(), move.from()) == 16) {
+                const Bitboard ep_mask = attacks::pawn(stm_, move.to().ep_square());
+                if (static_cast<bool>(ep_mask & pieces(PieceType::PAWN, ~stm_)))
+                    key ^= Zobrist::enpassant(move.to().ep_square().file());
+            }
+        }
+
+        if (pt == PieceType::KING) {
+            cr.clear(stm_);
+        } else if (pt == PieceType::ROOK && Square::back_rank(move.from(), stm_)) {
+            const auto file = CastlingRights::closestSide(move.from(), kingSq(stm_));
+            if (cr.getRookFile(stm_, file) == move.from().file()) cr.clear(stm_, file);
+        }
+
+        return key ^ Zobrist::castling(cr_.hashIndex()) ^ Zobrist::castling(cr.hashIndex());
+    }
     [[nodiscard]] Color sideToMove() const noexcept { return stm_; }
     [[nodiscard]] Square enpassantSq() const noexcept { return ep_sq_; }
     [[nodiscard]] CastlingRights castlingRights() const noexcept { return cr_; }
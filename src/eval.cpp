@@ -136,18 +136,44 @@ int countPassedPawns(const Board &board, Color color)
     return passed;
 }
 
-// Main evaluation function: always returns score from White's perspective (positive = good for White)
-int evaluateBoard(const Board &board, int plyFromRoot, Movelist &moves)
+// Pseudo-legal moves of color's pieces, counted straight from the attack tables
+int mobility(const Board &board, Color color)
 {
+    const Bitboard occupied = board.occ(), targets = ~board.us(color);
+    int count = 0;
 
-    if (moves.empty())
+    Bitboard pawns = board.pieces(PieceType::PAWN, color);
+    const int forward = color == Color::WHITE ? 8 : -8;
+    const Rank startRank = color == Color::WHITE ? Rank::RANK_2 : Rank::RANK_7;
+    while (pawns)
     {
-        if (board.sideToMove() == Color::WHITE)
-            return board.inCheck() ? (-MATE_SCORE + plyFromRoot) : 0;
-        else
-            return board.inCheck() ? (-MATE_SCORE + plyFromRoot) : 0;
+        int sq = pawns.pop();
+        count += (attacks::pawn(color, sq) & board.them(color)).count();
+        if (!occupied.check(sq + forward))
+        {
+            ++count;
+            if (Square(sq).rank() == startRank && !occupied.check(sq + 2 * forward))
+                ++count;
+        }
     }
 
+    Bitboard knights = board.pieces(PieceType::KNIGHT, color);
+    while (knights)
+        count += (attacks::knight(knights.pop()) & targets).count();
+    Bitboard diagonal = board.pieces(PieceType::BISHOP, color) | board.pieces(PieceType::QUEEN, color);
+    while (diagonal)
+        count += (attacks::bishop(diagonal.pop(), occupied) & targets).count();
+    Bitboard straight = board.pieces(PieceType::ROOK, color) | board.pieces(PieceType::QUEEN, color);
+    while (straight)
+        count += (attacks::rook(straight.pop(), occupied) & targets).count();
+    count += (attacks::king(board.kingSq(color)) & targets).count();
+
+    return count;
+}
+
+// Main evaluation function: returns the score from the side to move's point of view
+int evaluateBoard(const Board &board)
+{
     int score = 0;
     // for (size_t i = 0; i < 6; ++i)
     // {
@@ -228,7 +254,7 @@ int evaluateBoard(const Board &board, int plyFromRoot, Movelist &moves)
     score += kingSafety(board, Color::BLACK);
 
     // Mobility
-    score += (board.sideToMove() == Color::WHITE ? 1 : -1) * (moves.size() * 5);
+    score += (board.sideToMove() == Color::WHITE ? 1 : -1) * (mobility(board, board.sideToMove()) * 5);
 
     if (board.sideToMove() == Color::BLACK)
         score = -score;
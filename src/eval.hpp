@@ -3,6 +3,8 @@
 
 static const int MATERIAL_VALUES[6] = {100, 320, 330, 500, 900, 6000};
 static const int MATE_SCORE = 69000;
+// Scores beyond MATE_BOUND are mates
+static const int MATE_BOUND = MATE_SCORE - 1000;
 
 static const chess::PieceType ptArray[6] = {
     chess::PieceType::PAWN,
@@ -12,9 +14,12 @@ static const chess::PieceType ptArray[6] = {
     chess::PieceType::QUEEN,
     chess::PieceType::KING};
 
-int evaluateBoard(const chess::Board &board, int plyFromRoot, chess::Movelist &moves);
+// Static evaluation from the side to move's point of view. Does not detect
+// mate or stalemate; callers that generated the legal moves handle those.
+int evaluateBoard(const chess::Board &board);
 int pawnStructure(const chess::Board &board, chess::Color color);
 int kingSafety(const chess::Board &board, chess::Color color);
+// Pseudo-legal move count, ignoring pins, checks, castling and underpromotions
 int mobility(const chess::Board &board, chess::Color color);
 int countDoubledPawns(const chess::Board &board, chess::Color color);
 int countIsolatedPawns(const chess::Board &board, chess::Color color);
@@ -0,0 +1,73 @@
+#pragma once
+#include "chess.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+// [moved piece][to square]
+using PieceToHistory = int16_t[12][64];
+
+// Move statistics learned from beta cutoffs. Every update pulls an entry
+// towards its bonus ("gravity"), so entries stay within +-HISTORY_MAX and
+// stale knowledge fades by itself; the tables live for the whole game.
+struct History
+{
+    static constexpr int HISTORY_MAX = 16384;
+
+    // [moved piece][to]
+    PieceToHistory main = {};
+    // [moved piece][to][captured piece type]
+    int16_t capture[12][64][6] = {};
+    // [piece][to] of the move one or two plies back, then [piece][to] of this move
+    PieceToHistory continuation[12][64] = {};
+    // Quiet reply that last refuted a move: [piece][to] of the move refuted
+    chess::Move counterMoves[12][64] = {};
+
+    void clear()
+    {
+        std::fill_n(&main[0][0], 12 * 64, int16_t(0));
+        std::fill_n(&capture[0][0][0], 12 * 64 * 6, int16_t(0));
+        std::fill_n(&continuation[0][0][0][0], 12 * 64 * 12 * 64, int16_t(0));
+        std::fill_n(&counterMoves[0][0], 12 * 64, chess::Move(chess::Move::NO_MOVE));
+    }
+
+    static int bonus(int depth) { return std::min(16 * depth * depth + 32 * depth, 1200); }
+
+    static void update(int16_t &entry, int bonus)
+    {
+        entry = int16_t(entry + bonus - entry * std::abs(bonus) / HISTORY_MAX);
+    }
+
+    // Main history plus the continuation histories of the last two moves
+    int quietScore(chess::Piece piece, chess::Square to, const PieceToHistory *const continuations[2]) const
+    {
+        int score = main[piece][to.index()];
+        for (int i = 0; i < 2; ++i)
+            if (continuations[i])
+                score += (*continuations[i])[piece][to.index()];
+        return score;
+    }
+
+    void updateQuiet(chess::Piece piece, chess::Square to, PieceToHistory *const continuations[2], int bonus)
+    {
+        update(main[piece][to.index()], bonus);
+        for (int i = 0; i < 2; ++i)
+            if (continuations[i])
+                update((*continuations[i])[piece][to.index()], bonus);
+    }
+
+    int16_t &captureEntry(const chess::Board &board, chess::Move move)
+    {
+        return capture[board.at(move.from())][move.to().index()][capturedType(board, move)];
+    }
+    int captureScore(const chess::Board &board, chess::Move move) const
+    {
+        return capture[board.at(move.from())][move.to().index()][capturedType(board, move)];
+    }
+
+private:
+    static int capturedType(const chess::Board &board, chess::Move move)
+    {
+        return move.typeOf() == chess::Move::ENPASSANT ? (int)chess::PieceType::PAWN : (int)board.at(move.to()).type();
+    }
+};
@@ -0,0 +1,176 @@
+#include "largepages.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#endif
+
+const char *largePageModeName(LargePageMode mode)
+{
+    switch (mode)
+    {
+    case LargePageMode::TRANSPARENT:
+        return "transparent huge pages";
+    case LargePageMode::EXPLICIT:
+        return "explicit huge pages (MAP_HUGETLB)";
+    case LargePageMode::FILE_MAPPING:
+        return "a copy-on-write file mapping";
+    case LargePageMode::SHARED_MEMORY:
+        return "shared memory";
+    default:
+        return "regular pages";
+    }
+}
+
+#if defined(__linux__)
+// madvise succeeds even when THP is switched off system-wide
+static bool transparentHugePagesEnabled()
+{
+    std::ifstream f("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string setting;
+    std::getline(f, setting);
+    return f && setting.find("[never]") == std::string::npos;
+}
+#endif
+
+bool LargePageBuffer::allocate(size_t size, bool allowExplicit)
+{
+    release();
+    size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+#if defined(__linux__)
+    if (allowExplicit)
+    {
+        void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED)
+        {
+            ptr = mem;
+            bytes = size;
+            pageMode = LargePageMode::EXPLICIT;
+            return true;
+        }
+    }
+#endif
+
+#if defined(_WIN32)
+    ptr = _aligned_malloc(size, HUGE_PAGE_SIZE);
+#else
+    ptr = std::aligned_alloc(HUGE_PAGE_SIZE, size);
+#endif
+    if (!ptr)
+        return false;
+    bytes = size;
+    pageMode = LargePageMode::NONE;
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (madvise(ptr, size, MADV_HUGEPAGE) == 0 && transparentHugePagesEnabled())
+        pageMode = LargePageMode::TRANSPARENT;
+#endif
+    return true;
+}
+
+bool LargePageBuffer::mapFile(const std::string &path, size_t offset, size_t size)
+{
+    release();
+#if defined(__linux__) || defined(__APPLE__)
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    void *mem = mmap(nullptr, offset + size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return false;
+    mapping = mem;
+    mappingSize = offset + size;
+    ptr = static_cast<char *>(mem) + offset;
+    bytes = size;
+    pageMode = LargePageMode::FILE_MAPPING;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool LargePageBuffer::mapShared(const std::string &name, size_t size, bool &created)
+{
+    release();
+    created = false;
+#if defined(__linux__) || defined(__APPLE__)
+    // O_EXCL decides which process creates and sizes the segment
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0)
+    {
+        if (ftruncate(fd, off_t(size)) != 0)
+        {
+            close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+        created = true;
+    }
+    else
+    {
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0)
+            return false;
+        // The creator may not have sized it yet
+        struct stat st = {};
+        for (int i = 0; i < 5000 && fstat(fd, &st) == 0 && st.st_size == 0; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        size = size_t(st.st_size);
+    }
+
+    void *mem = size ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        if (created)
+            shm_unlink(name.c_str());
+        created = false;
+        return false;
+    }
+    ptr = mem;
+    bytes = size;
+    pageMode = LargePageMode::SHARED_MEMORY;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void LargePageBuffer::unlinkShared(const std::string &name)
+{
+#if defined(__linux__) || defined(__APPLE__)
+    shm_unlink(name.c_str());
+#endif
+}
+
+void LargePageBuffer::release()
+{
+    if (!ptr)
+        return;
+#if defined(__linux__) || defined(__APPLE__)
+    if (pageMode == LargePageMode::FILE_MAPPING)
+        munmap(mapping, mappingSize);
+    else if (pageMode == LargePageMode::EXPLICIT || pageMode == LargePageMode::SHARED_MEMORY)
+        munmap(ptr, bytes);
+    else
+        std::free(ptr);
+#elif defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+    ptr = nullptr;
+    bytes = 0;
+    mapping = nullptr;
+    mappingSize = 0;
+    pageMode = LargePageMode::NONE;
+}
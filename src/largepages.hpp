@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// How a LargePageBuffer's memory is backed
+enum class LargePageMode
+{
+    NONE,        // regular pages
+    TRANSPARENT, // 2 MB aligned, madvise(MADV_HUGEPAGE)
+    EXPLICIT,    // mmap(MAP_HUGETLB) from the reserved huge page pool
+    FILE_MAPPING, // private copy-on-write mapping of a file
+    SHARED_MEMORY // named POSIX shared memory segment
+};
+
+const char *largePageModeName(LargePageMode mode);
+
+// Owns a block of memory aligned for 2 MB huge pages, for the transposition
+// table and any other large hash table. Falls back to regular pages when
+// huge pages are unavailable. The memory is not initialized.
+class LargePageBuffer
+{
+public:
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    LargePageBuffer() = default;
+    ~LargePageBuffer() { release(); }
+    LargePageBuffer(const LargePageBuffer &) = delete;
+    LargePageBuffer &operator=(const LargePageBuffer &) = delete;
+
+    // Tries MAP_HUGETLB first when allowExplicit is set. Returns false if
+    // even a regular allocation failed.
+    bool allocate(size_t bytes, bool allowExplicit);
+    // Maps bytes of path starting at offset (a multiple of the page size)
+    // instead of allocating. Writes stay private to this process.
+    bool mapFile(const std::string &path, size_t offset, size_t bytes);
+    // Maps the shared memory segment name, creating it with bytes if it does
+    // not exist yet (created is then set). An existing segment keeps its size.
+    bool mapShared(const std::string &name, size_t bytes, bool &created);
+    static void unlinkShared(const std::string &name);
+    void release();
+
+    void *data() const { return ptr; }
+    size_t size() const { return bytes; }
+    LargePageMode mode() const { return pageMode; }
+
+private:
+    void *ptr = nullptr;
+    size_t bytes = 0;
+    void *mapping = nullptr; // start of the file mapping, before offset
+    size_t mappingSize = 0;
+    LargePageMode pageMode = LargePageMode::NONE;
+};
@@ -5,8 +5,63 @@
 #include "book.hpp"
 #include "search.hpp"
 #include "eval.hpp"
+#include "threads.hpp"
+#include <algorithm>
+#include <charconv>
+#include <new>
+#include <thread>
 using namespace chess;
 
+constexpr int MAX_THREADS = 256;
+
+// Runs go commands so the input loop keeps reading stop, isready and quit
+static std::thread searchThread;
+
+// Blocks until the running search, if any, has printed its bestmove
+static void waitForSearch()
+{
+    if (searchThread.joinable())
+        searchThread.join();
+}
+
+static void stopSearch()
+{
+    Threads.requestStop();
+    waitForSearch();
+}
+
+// Parses the value of a spin option into [min, max]. Values that are not a
+// whole number are rejected and out of range ones clamped, both with an
+// info string, so a bad setoption never takes the engine down.
+static bool parseSpinValue(const std::string &name, const std::string &value, long long min, long long max,
+                           long long &out)
+{
+    const char *end = value.data() + value.size();
+    auto [ptr, ec] = std::from_chars(value.data(), end, out);
+    if (ec == std::errc::invalid_argument || ptr != end)
+    {
+        std::cout << "info string Ignoring invalid " << name << " value '" << value << "'\n";
+        return false;
+    }
+    if (ec == std::errc::result_out_of_range)
+        out = value[0] == '-' ? min : max;
+    if (out < min || out > max || ec == std::errc::result_out_of_range)
+    {
+        out = std::clamp(out, min, max);
+        std::cout << "info string " << name << " value " << value << " clamped to " << out << "\n";
+    }
+    return true;
+}
+
+static void configureHash(size_t megabytes, bool largePages, const std::string &sharedHash)
+{
+    // Processes naming the same segment share one table
+    if (sharedHash.empty())
+        TT.resize(megabytes, largePages);
+    else
+        TT.attachShared((sharedHash[0] == '/' ? "" : "/") + sharedHash, megabytes, Threads.count());
+}
+
 void benchmarking()
 {
 
@@ -15,11 +70,9 @@ void benchmarking()
     Board board;
     board.setFen(chess::constants::STARTPOS);
 
-    Movelist moves;
-    movegen::legalmoves(moves, board);
     for (size_t i = 0; i < evalNum; ++i)
     {
-        evaluateBoard(board, 0, moves);
+        evaluateBoard(board);
     }
 
     auto end = std::chrono::steady_clock::now();
@@ -57,6 +110,9 @@ int main(int argc, char *argv[])
 
     Board board;
     std::string line;
+    size_t hashMB = TranspositionTable::DEFAULT_MB;
+    bool largePages = false;
+    std::string sharedHash;
 
     while (std::getline(std::cin, line))
     {
@@ -64,19 +120,105 @@ int main(int argc, char *argv[])
         {
             std::cout << "id name OmbleCavalierCPP\n";
             std::cout << "id author Hughes Perreault\n";
+            std::cout << "option name Hash type spin default " << TranspositionTable::DEFAULT_MB
+                      << " min 1 max " << TranspositionTable::MAX_MB << "\n";
+            std::cout << "option name LargePages type check default false\n";
+            std::cout << "option name SharedHash type string default <empty>\n";
+            std::cout << "option name Threads type spin default 1 min 1 max " << MAX_THREADS << "\n";
+            std::cout << "option name SMPMode type combo default LazySMP var LazySMP var ABDADA\n";
+            std::cout << "option name ReverseFutility type check default true\n";
+            std::cout << "option name Futility type check default true\n";
+            std::cout << "option name Razoring type check default true\n";
+            std::cout << "option name LateMovePruning type check default true\n";
+            std::cout << "option name Ponder type check default false\n";
             std::cout << "uciok\n";
         }
         else if (line == "isready")
         {
-            std::cout << "readyok\n";
+            // Pay for clearing and page faults here rather than in go, unless
+            // a search is using the table
+            if (!searchThread.joinable())
+                TT.ensureReady(Threads.count());
+            sendLine("readyok");
+        }
+        else if (line == "stop")
+        {
+            stopSearch();
+        }
+        else if (line == "ponderhit")
+        {
+            // The opponent played the expected move: the search goes on, now on our clock
+            Threads.mainContext().ponder = false;
+        }
+        else if (line.rfind("setoption", 0) == 0)
+        {
+            waitForSearch();
+            // setoption name <id> value <x>
+            std::istringstream ss(line);
+            std::string token, name, value;
+            ss >> token >> token;
+            while (ss >> token && token != "value")
+                name += (name.empty() ? "" : " ") + token;
+            std::getline(ss >> std::ws, value);
+
+            if (name == "Threads")
+            {
+                long long count = 0;
+                if (!parseSpinValue(name, value, 1, MAX_THREADS, count))
+                    continue;
+                Threads.setCount(size_t(count));
+                std::cout << "info string Using " << Threads.count() << " search threads\n";
+            }
+            else if (name == "SMPMode")
+            {
+                Threads.setMode(value == "ABDADA" ? SmpMode::ABDADA : SmpMode::LAZY_SMP);
+                std::cout << "info string SMP mode " << (value == "ABDADA" ? "ABDADA" : "LazySMP") << "\n";
+            }
+            else if (name == "ReverseFutility")
+                Pruning.reverseFutility = (value == "true");
+            else if (name == "Futility")
+                Pruning.futility = (value == "true");
+            else if (name == "Razoring")
+                Pruning.razoring = (value == "true");
+            else if (name == "LateMovePruning")
+                Pruning.lateMovePruning = (value == "true");
+            else if (name == "Hash" || name == "LargePages" || name == "SharedHash")
+            {
+                long long mb = 0;
+                if (name == "Hash" && !parseSpinValue(name, value, 1, (long long)TranspositionTable::MAX_MB, mb))
+                    continue;
+                const size_t previousMB = TT.sizeMB();
+                if (name == "Hash")
+                    hashMB = size_t(mb);
+                else if (name == "LargePages")
+                    largePages = (value == "true");
+                else
+                    sharedHash = (value == "<empty>") ? "" : value;
+
+                try
+                {
+                    configureHash(hashMB, largePages, sharedHash);
+                }
+                catch (const std::bad_alloc &)
+                {
+                    std::cout << "info string Not enough memory for a " << hashMB << " MB hash\n";
+                    hashMB = previousMB;
+                    configureHash(hashMB, largePages, sharedHash);
+                }
+                std::cout << "info string Hash set to " << TT.sizeMB() << " MB using "
+                          << largePageModeName(TT.pageMode()) << "\n";
+            }
         }
         else if (line == "ucinewgame")
         {
+            waitForSearch();
             board.setFen(chess::constants::STARTPOS);
-            TT.clear();
+            TT.scheduleClear();
+            Threads.clearHistories();
         }
         else if (line.rfind("position", 0) == 0)
         {
+            waitForSearch();
             if (line.find("startpos") != std::string::npos)
             {
                 board.setFen(chess::constants::STARTPOS);
@@ -95,8 +237,10 @@ int main(int argc, char *argv[])
         }
         else if (line.rfind("go", 0) == 0)
         {
+            waitForSearch();
             double total_time_remaining = 5.0; // default seconds
             double increment = 0.0;
+            bool ponder = false;
             int moveNumber = board.fullMoveNumber();
 
             std::istringstream ss(line);
@@ -107,7 +251,9 @@ int main(int argc, char *argv[])
                 // {
                 //     ss >> MAX_DEPTH;
                 // }
-                if (token == "movetime")
+                if (token == "ponder")
+                    ponder = true;
+                else if (token == "movetime")
                 {
                     int ms;
                     ss >> ms;
@@ -139,33 +285,64 @@ int main(int argc, char *argv[])
                 }
             }
 
-            // Try Polyglot book first
-            if (BOOK_LOADED || loadPolyglotBook(BOOK_PATH))
+            // Try Polyglot book first; a ponder search may not answer before ponderhit
+            if (!ponder && (BOOK_LOADED || loadPolyglotBook(BOOK_PATH)))
             {
                 if (auto bm = getBookMove(board))
                 {
                     std::cout << "info string book move found\n";
-                    std::cout << "bestmove " << uci::moveToUci(*bm) << "\n";
+                    std::cout << "bestmove " << uci::moveToUci(*bm) << std::endl;
                     continue;
                 }
             }
 
-            Move best = findBestMoveIterative(board, MAX_DEPTH, total_time_remaining, increment);
-            std::cout << "bestmove " << uci::moveToUci(best) << "\n";
+            // A stop that arrives from here on ends this search
+            Threads.mainContext().stop = false;
+            Threads.mainContext().ponder = ponder;
+            searchThread = std::thread([board, total_time_remaining, increment]() mutable
+                                       {
+                SearchContext &ctx = Threads.mainContext();
+                Move best = findBestMoveIterative(board, MAX_DEPTH, total_time_remaining, increment);
+                // bestmove must wait for ponderhit or stop, even if the search ran out of depth
+                while (ctx.ponder && !ctx.stop)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                Move reply = ponderMove(ctx, board, best);
+                std::string bestmove = "bestmove " + uci::moveToUci(best);
+                if (reply != Move::NO_MOVE)
+                    bestmove += " ponder " + uci::moveToUci(reply);
+                sendLine(bestmove); });
         }
         else if (line == "quit")
         {
             break;
         }
+        else if (line.rfind("savehash ", 0) == 0)
+        {
+            waitForSearch();
+            std::string path = line.substr(9);
+            if (TT.save(path))
+                std::cout << "info string Saved " << TT.sizeMB() << " MB hash to " << path << "\n";
+        }
+        else if (line.rfind("loadhash ", 0) == 0)
+        {
+            waitForSearch();
+            std::string path = line.substr(9);
+            if (TT.load(path))
+                std::cout << "info string Loaded " << TT.sizeMB() << " MB hash from " << path << " using "
+                          << largePageModeName(TT.pageMode()) << "\n";
+        }
         else if (line == "puzzletest")
         {
+            waitForSearch();
             runPuzzleTests();
             std::cout << "info string Puzzle tests complete\n";
         }
         else if (line == "benchmarking")
         {
+            waitForSearch();
             benchmarking();
             std::cout << "info string benchmarking complete\n";
         }
     }
+    stopSearch();
 }
@@ -0,0 +1,174 @@
+#include "movepick.hpp"
+#include <algorithm>
+#include "eval.hpp"
+#include "utils.hpp"
+using namespace chess;
+
+// Capture history only breaks ties within about one MVV-LVA victim class
+constexpr int CAPTURE_HISTORY_DIVISOR = 16;
+
+MovePicker::MovePicker(const Board &board, const Movelist &legalMoves, Move ttMove, const Move killers[2],
+                       Move counterMove, const History *history, const PieceToHistory *const continuations[2])
+    : board(board), history(history), continuations{continuations[0], continuations[1]}, ttMove(ttMove),
+      killers{killers[0], killers[1]}, counterMove(counterMove), currentStage(TT_MOVE)
+{
+    // Captures and promotions first, quiets behind them
+    int quietBegin = legalMoves.size();
+    for (const Move &move : legalMoves)
+    {
+        if (board.isCapture(move) || move.typeOf() == Move::PROMOTION)
+            moves[captureEnd++] = {move, 0};
+        else
+            moves[--quietBegin] = {move, 0};
+    }
+    moveCount = legalMoves.size();
+
+    if (std::find(legalMoves.begin(), legalMoves.end(), ttMove) == legalMoves.end())
+        this->ttMove = Move::NO_MOVE;
+}
+
+static const Move NO_KILLERS[2] = {Move::NO_MOVE, Move::NO_MOVE};
+static const PieceToHistory *const NO_CONTINUATIONS[2] = {nullptr, nullptr};
+
+MovePicker::MovePicker(const Board &board, const Movelist &legalMoves)
+    : MovePicker(board, legalMoves, Move::NO_MOVE, NO_KILLERS, Move::NO_MOVE, nullptr, NO_CONTINUATIONS)
+{
+    quiescence = true;
+    currentStage = INIT_CAPTURES;
+}
+
+MovePicker::ScoredMove MovePicker::pickBest()
+{
+    int best = cur;
+    for (int i = cur + 1; i < end; ++i)
+        if (moves[i].score > moves[best].score)
+            best = i;
+    std::swap(moves[cur], moves[best]);
+    return moves[cur++];
+}
+
+bool MovePicker::isQuiet(Move m) const
+{
+    if (m == Move::NO_MOVE || m == ttMove)
+        return false;
+    for (int i = captureEnd; i < moveCount; ++i)
+        if (moves[i].move == m)
+            return true;
+    return false;
+}
+
+void MovePicker::scoreCaptures()
+{
+    for (int i = 0; i < captureEnd; ++i)
+    {
+        Move move = moves[i].move;
+        moves[i].score = mvvLvaScore(board, move);
+        if (history && board.isCapture(move))
+            moves[i].score += history->captureScore(board, move) / CAPTURE_HISTORY_DIVISOR;
+        if (move.typeOf() == Move::PROMOTION)
+            moves[i].score += 10 * MATERIAL_VALUES[(int)move.promotionType()];
+    }
+}
+
+void MovePicker::sortQuiets()
+{
+    // Insertion sort, best history first; a node rarely has more than a few dozen quiets
+    for (int i = captureEnd; i < moveCount; ++i)
+    {
+        Move move = moves[i].move;
+        moves[i].score = history ? history->quietScore(board.at(move.from()), move.to(), continuations) : 0;
+    }
+    for (int i = captureEnd + 1; i < moveCount; ++i)
+    {
+        ScoredMove scored = moves[i];
+        int j = i;
+        for (; j > captureEnd && moves[j - 1].score < scored.score; --j)
+            moves[j] = moves[j - 1];
+        moves[j] = scored;
+    }
+}
+
+Move MovePicker::next()
+{
+    switch (currentStage)
+    {
+    case TT_MOVE:
+        currentStage = INIT_CAPTURES;
+        if (ttMove != Move::NO_MOVE)
+            return ttMove;
+        [[fallthrough]];
+
+    case INIT_CAPTURES:
+        scoreCaptures();
+        cur = 0;
+        end = captureEnd;
+        currentStage = GOOD_CAPTURES;
+        [[fallthrough]];
+
+    case GOOD_CAPTURES:
+        while (cur < end)
+        {
+            ScoredMove scored = pickBest();
+            if (scored.move == ttMove)
+                continue;
+            // Losing captures wait until after the quiets
+            if (!quiescence && !staticExchangeAtLeast(board, scored.move, 0))
+            {
+                moves[badEnd++] = scored;
+                continue;
+            }
+            return scored.move;
+        }
+        currentStage = quiescence ? INIT_QUIETS : KILLER_1;
+        if (quiescence)
+            return next();
+        [[fallthrough]];
+
+    case KILLER_1:
+        currentStage = KILLER_2;
+        if (isQuiet(killers[0]))
+            return killers[0];
+        [[fallthrough]];
+
+    case KILLER_2:
+        currentStage = COUNTER_MOVE;
+        if (killers[1] != killers[0] && isQuiet(killers[1]))
+            return killers[1];
+        [[fallthrough]];
+
+    case COUNTER_MOVE:
+        currentStage = INIT_QUIETS;
+        if (counterMove != killers[0] && counterMove != killers[1] && isQuiet(counterMove))
+            return counterMove;
+        [[fallthrough]];
+
+    case INIT_QUIETS:
+        sortQuiets();
+        cur = captureEnd;
+        end = moveCount;
+        currentStage = QUIETS;
+        [[fallthrough]];
+
+    case QUIETS:
+        while (cur < end)
+        {
+            Move move = moves[cur++].move;
+            if (move != ttMove && move != killers[0] && move != killers[1] && move != counterMove)
+                return move;
+        }
+        cur = 0;
+        end = badEnd;
+        currentStage = BAD_CAPTURES;
+        [[fallthrough]];
+
+    case BAD_CAPTURES:
+        if (cur < end)
+            return moves[cur++].move;
+        currentStage = DONE;
+        [[fallthrough]];
+
+    case DONE:
+        break;
+    }
+    return Move::NO_MOVE;
+}
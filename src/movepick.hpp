@@ -0,0 +1,68 @@
+#pragma once
+#include "chess.hpp"
+#include "history.hpp"
+
+// Hands out the moves of a node one at a time, best first, doing only as
+// much ordering work as the node consumes before it cuts off:
+// TT move, winning captures, killers and countermove, quiets by history,
+// then the captures SEE says are losing. Scores live in an inline array,
+// so picking never allocates.
+class MovePicker
+{
+public:
+    enum Stage
+    {
+        TT_MOVE,
+        INIT_CAPTURES,
+        GOOD_CAPTURES,
+        KILLER_1,
+        KILLER_2,
+        COUNTER_MOVE,
+        INIT_QUIETS,
+        QUIETS,
+        BAD_CAPTURES,
+        DONE
+    };
+
+    // Main search, over the legal moves of the node
+    // continuations are the continuation tables of the last two moves, null where there is none
+    MovePicker(const chess::Board &board, const chess::Movelist &moves, chess::Move ttMove,
+               const chess::Move killers[2], chess::Move counterMove, const History *history,
+               const PieceToHistory *const continuations[2]);
+    // Quiescence: captures by MVV-LVA, then whatever else moves holds (evasions,
+    // promotions), without the SEE split
+    MovePicker(const chess::Board &board, const chess::Movelist &moves);
+
+    // NO_MOVE once every move has been returned
+    chess::Move next();
+    Stage stage() const { return currentStage; }
+
+private:
+    struct ScoredMove
+    {
+        chess::Move move;
+        int score;
+    };
+
+    // Swaps the best scored move of [cur, end) into cur and returns it
+    ScoredMove pickBest();
+    // Whether m is one of this node's quiet moves and not the TT move
+    bool isQuiet(chess::Move m) const;
+    void scoreCaptures();
+    void sortQuiets();
+
+    const chess::Board &board;
+    const History *history = nullptr;
+    const PieceToHistory *continuations[2] = {nullptr, nullptr};
+    chess::Move ttMove = chess::Move::NO_MOVE;
+    chess::Move killers[2] = {chess::Move::NO_MOVE, chess::Move::NO_MOVE};
+    chess::Move counterMove = chess::Move::NO_MOVE;
+    bool quiescence = false;
+
+    Stage currentStage;
+    // [0, captureEnd) captures, [captureEnd, moveCount) quiets; losing captures
+    // are parked in the already consumed slots [0, badEnd)
+    ScoredMove moves[chess::constants::MAX_MOVES];
+    int moveCount = 0, captureEnd = 0, badEnd = 0;
+    int cur = 0, end = 0;
+};
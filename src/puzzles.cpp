@@ -1,5 +1,6 @@
 #include "puzzles.hpp"
 #include "search.hpp"
+#include "threads.hpp"
 #include "tt.hpp"
 using namespace chess;
 
@@ -15,7 +16,7 @@ void runPuzzleTests()
         {"8/1Q6/2PBK3/k7/8/2P2P2/8/7q w - - 7 63", "mate in 2", "d6c7", 4},
         {"r3k2r/ppp2Npp/1b5n/4p2b/2B1P2q/BQP2P2/P5PP/RN5K w kq - 1 0", "mate in 3", "c4b5", 6},
         {"r2n1rk1/1ppb2pp/1p1p4/3Ppq1n/2B3P1/2P4P/PP1N1P1K/R2Q1RN1 b - - 0 1", "mate in 3", "f5f2", 6},
-        {"8/8/8/3k4/1Q1Np2p/1p2P2P/1Pp2b2/2K5 w - - 1 50", "mate in 6", "b4a5", 12},
+        {"8/8/8/3k4/1Q1Np2p/1p2P2P/1Pp2b2/2K5 w - - 1 50", "mate in 6", "b4a5", 8},
 
     };
 
@@ -52,8 +53,9 @@ void runPuzzleTests()
             std::cout << " (" << puzzle.description << ")";
         }
         std::cout << " - Expected: " << puzzle.expected_best_move << ", Got: " << bestMoveUci;
-        std::cout << " | Time: " << elapsed << "s" << std::endl;
+        std::cout << " | Time: " << elapsed << "s | Nodes: " << Threads.nodesSearched() << std::endl;
         TT.clear();
+        Threads.clearHistories();
     }
 
     auto overall_end = std::chrono::steady_clock::now();
@@ -68,6 +70,7 @@ bool runSingleTest(const std::string &fen, const std::string &expectedMove, int
     Board board;
     board.setFen(fen);
     TT.clear();
+    Threads.clearHistories();
 
     // Allocate plenty of time for the test
     Move bestMove = findBestMoveIterative(board, depth, 60.0);
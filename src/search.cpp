@@ -1,39 +1,193 @@
 #include "search.hpp"
 #include "eval.hpp"
+#include "movepick.hpp"
+#include "threads.hpp"
 #include "tt.hpp"
 #include "utils.hpp"
+#include <array>
 #include <climits>
+#include <mutex>
+#include <sstream>
 using namespace chess;
 
-constexpr int MAX_PLY = 128; // or whatever your max search depth is
+// Late move reductions apply to quiet moves from this depth and move number on
+constexpr int LMR_MIN_DEPTH = 3;
+constexpr int LMR_MIN_MOVE = 3;
+// Quiet history score (main plus continuations) worth one ply of reduction
+constexpr int LMR_HISTORY_DIVISOR = 8192;
+
+// Forward pruning margins, in centipawns
+constexpr int RFP_MAX_DEPTH = 6;
+constexpr int RFP_MARGIN = 100;          // per ply
+constexpr int RAZOR_MAX_DEPTH = 2;
+constexpr int RAZOR_MARGIN = 300;        // times depth squared
+constexpr int FUTILITY_MAX_DEPTH = 3;
+constexpr int FUTILITY_MARGIN = 100;     // plus FUTILITY_MARGIN_PER_PLY * depth
+constexpr int FUTILITY_MARGIN_PER_PLY = 150;
+constexpr int LMP_MAX_DEPTH = 3;
+constexpr int LMP_BASE = 3;              // quiet moves kept: LMP_BASE + depth * depth
+constexpr int DELTA_MARGIN = 200;        // quiescence: positional slack on top of the captured piece
+
+// Extensions stop at twice the root depth, and never go past this ply
+constexpr int MAX_EXTENSION_PLY = MAX_PLY / 2;
+// The TT move is singular when every other move fails low against its
+// score minus this margin per ply, at half the depth
+constexpr int SINGULAR_MIN_DEPTH = 6;
+constexpr int SINGULAR_MARGIN_PER_PLY = 2;
+
+PruningOptions Pruning;
+
+// Natural log, usable in constant expressions (std::log is not constexpr)
+static constexpr double constexprLog(double x)
+{
+    // ln(x) = k ln(2) + ln(m) with m in [1, 2), then the atanh series for ln(m)
+    int k = 0;
+    while (x >= 2.0)
+    {
+        x /= 2.0;
+        ++k;
+    }
+    double y = (x - 1.0) / (x + 1.0), term = y, sum = 0.0;
+    for (int n = 1; n < 40; n += 2)
+    {
+        sum += term / n;
+        term *= y * y;
+    }
+    return k * 0.6931471805599453 + 2.0 * sum;
+}
 
-// Two killer moves per ply
-static Move killerMoves[MAX_PLY][2];
+// Base reduction by [depth][move number], grows with the log of both
+static constexpr auto LMR_TABLE = []()
+{
+    std::array<std::array<int8_t, 64>, 64> table{};
+    for (int depth = 1; depth < 64; ++depth)
+        for (int move = 1; move < 64; ++move)
+            table[depth][move] = int8_t(0.75 + constexprLog(depth) * constexprLog(move) / 2.25);
+    return table;
+}();
 
-// History heuristic table: [from][to]
-static int historyHeuristic[64][64];
+static_assert(LMR_TABLE[1][1] == 0 && LMR_TABLE[8][20] == 3 && LMR_TABLE[63][63] == 8);
 
-// Quiescence search with draw/mate/stalemate detection
-int quiesce(Board &board, int alpha, int beta, int plyFromRoot)
+void SearchContext::clear()
 {
-    chess::Movelist legalMoves;
-    movegen::legalmoves(legalMoves, board);
+    for (auto &entry : stack)
+        entry = SearchStackEntry{};
+    for (int &length : pvLength)
+        length = 0;
+    previousPvLength = 0;
+    selDepth = 0;
+}
 
-    int stand_pat = evaluateBoard(board, plyFromRoot, legalMoves);
+Move *SearchContext::counterMoveSlot(int plyFromRoot)
+{
+    if (plyFromRoot == 0)
+        return nullptr;
+    const SearchStackEntry &previous = stack[plyFromRoot - 1];
+    if (previous.movedPiece == Piece::NONE)
+        return nullptr;
+    return &history.counterMoves[previous.movedPiece][previous.currentMove.to().index()];
+}
 
-    if (stand_pat >= beta)
-        return stand_pat;
+PieceToHistory *SearchContext::continuationHistory(int plyFromRoot)
+{
+    if (plyFromRoot < 0 || stack[plyFromRoot].movedPiece == Piece::NONE)
+        return nullptr;
+    return &history.continuation[stack[plyFromRoot].movedPiece][stack[plyFromRoot].currentMove.to().index()];
+}
 
-    if (stand_pat > alpha)
-        alpha = stand_pat;
+void SearchContext::updatePv(int plyFromRoot, Move move)
+{
+    Move *line = pv[plyFromRoot];
+    line[plyFromRoot] = move;
+    int childLength = plyFromRoot + 1 < MAX_PLY ? pvLength[plyFromRoot + 1] : plyFromRoot + 1;
+    for (int i = plyFromRoot + 1; i < childLength; ++i)
+        line[i] = pv[plyFromRoot + 1][i];
+    pvLength[plyFromRoot] = std::max(childLength, plyFromRoot + 1);
+}
 
-    for (auto move : legalMoves)
+Move SearchContext::previousPvMove(int plyFromRoot) const
+{
+    if (plyFromRoot >= previousPvLength)
+        return Move::NO_MOVE;
+    for (int i = 0; i < plyFromRoot; ++i)
+        if (stack[i].currentMove != previousPv[i])
+            return Move::NO_MOVE;
+    return previousPv[plyFromRoot];
+}
+
+bool SearchContext::checkStop()
+{
+    using namespace std::chrono;
+    if (timedOut)
+        return true;
+    if (stop.load(std::memory_order_relaxed))
+        timedOut = true;
+    else if (--clockPollCountdown <= 0)
     {
-        if (!board.isCapture(move))
-            continue;
+        clockPollCountdown = CLOCK_POLL_NODES;
+        if (ponder.load(std::memory_order_relaxed))
+            start = steady_clock::now();
+        else
+            timedOut = duration<double>(steady_clock::now() - start).count() > timeLimit;
+    }
+    return timedOut;
+}
+
+// Quiescence search with draw/mate/stalemate detection
+int quiesce(SearchContext &ctx, Board &board, int alpha, int beta, int plyFromRoot)
+{
+    ctx.countNode();
+    ctx.selDepth = std::max(ctx.selDepth, plyFromRoot);
+
+    // In check every evasion is searched and there is no standing pat.
+    // Otherwise only captures and promotions, found without generating the quiets.
+    const bool inCheck = board.inCheck();
+    chess::Movelist moves;
+    int stand_pat;
+    if (inCheck)
+    {
+        movegen::legalmoves(moves, board);
+        if (moves.empty())
+            return -MATE_SCORE + plyFromRoot;
+        stand_pat = -MATE_SCORE + plyFromRoot;
+    }
+    else
+    {
+        movegen::legalmoves<movegen::MoveGenType::CAPTURE>(moves, board);
+        const Bitboard seventh = board.sideToMove() == Color::WHITE ? Bitboard(Rank::RANK_7) : Bitboard(Rank::RANK_2);
+        if (board.pieces(PieceType::PAWN, board.sideToMove()) & seventh)
+        {
+            chess::Movelist quiets;
+            movegen::legalmoves<movegen::MoveGenType::QUIET>(quiets, board);
+            for (auto move : quiets)
+                if (move.typeOf() == Move::PROMOTION && move.promotionType() == PieceType::QUEEN)
+                    moves.add(move);
+        }
+
+        stand_pat = evaluateBoard(board);
+        if (stand_pat >= beta)
+            return stand_pat;
+        if (stand_pat > alpha)
+            alpha = stand_pat;
+    }
+
+    MovePicker picker(board, moves);
+    Move move;
+    while ((move = picker.next()) != Move::NO_MOVE)
+    {
+        if (!inCheck && move.typeOf() != Move::PROMOTION)
+        {
+            // Delta pruning: even winning the piece for free leaves us below alpha
+            int captured = move.typeOf() == Move::ENPASSANT ? MATERIAL_VALUES[0] : getPieceValue(board, move.to());
+            if (stand_pat + captured + DELTA_MARGIN <= alpha)
+                continue;
+            // Captures that lose material in the exchange
+            if (!staticExchangeAtLeast(board, move, 0))
+                continue;
+        }
 
         board.makeMove(move);
-        int score = -quiesce(board, -beta, -alpha, plyFromRoot + 1);
+        int score = -quiesce(ctx, board, -beta, -alpha, plyFromRoot + 1);
         board.unmakeMove(move);
 
         if (score >= beta)
@@ -46,26 +200,75 @@ int quiesce(Board &board, int alpha, int beta, int plyFromRoot)
     return stand_pat;
 }
 
-// Negamax search (returns only score, not move)
-int negamax(Board &board, int depth, int alpha, int beta,
-            std::chrono::steady_clock::time_point start, double timeLimit, int plyFromRoot, bool &timedOut)
+// Searches the moves after the first with a null window, reduced by
+// reduction plies. A reduced move that beats alpha is verified at full depth,
+// and at PV nodes a fail-high inside the window is re-searched with the full
+// window. Whatever the rest of the line, a move made from a non-PV node leads
+// to a non-PV node.
+template <NodeType nodeType>
+static int searchMove(SearchContext &ctx, Board &board, int moveIndex, int depth, int reduction,
+                      int alpha, int beta, int plyFromRoot)
 {
-    using namespace std::chrono;
-    if (timedOut)
+    constexpr bool pvNode = nodeType == NodeType::PV;
+    if (pvNode && moveIndex == 0)
+        return -negamax<NodeType::PV>(ctx, board, depth - 1, -beta, -alpha, plyFromRoot + 1);
+
+    int score = -negamax<NodeType::NON_PV>(ctx, board, depth - 1 - reduction, -alpha - 1, -alpha, plyFromRoot + 1);
+    if (reduction > 0 && score > alpha && !ctx.timedOut)
+        score = -negamax<NodeType::NON_PV>(ctx, board, depth - 1, -alpha - 1, -alpha, plyFromRoot + 1);
+    if (pvNode && score > alpha && score < beta && !ctx.timedOut)
+        score = -negamax<NodeType::PV>(ctx, board, depth - 1, -beta, -alpha, plyFromRoot + 1);
+    return score;
+}
+
+// How many plies to take off a late quiet move. Killers, moves with good
+// history and PV nodes are reduced less, moves with bad history more;
+// checks and check evasions are not reduced at all.
+template <NodeType nodeType>
+static int lateMoveReduction(const SearchContext &ctx, Move move, int moveIndex, int depth, int plyFromRoot,
+                             bool inCheck, bool givesCheck, int historyScore)
+{
+    if (depth < LMR_MIN_DEPTH || moveIndex < LMR_MIN_MOVE || inCheck || givesCheck)
         return 0;
-    if (duration<double>(steady_clock::now() - start).count() > timeLimit)
-    {
-        timedOut = true;
+
+    int reduction = LMR_TABLE[std::min(depth, 63)][std::min(moveIndex, 63)];
+    if (nodeType == NodeType::PV)
+        --reduction;
+    const Move *killers = ctx.stack[plyFromRoot].killers;
+    if (move == killers[0] || move == killers[1])
+        --reduction;
+    reduction -= historyScore / LMR_HISTORY_DIVISOR;
+
+    // Never drop straight into quiescence
+    return std::clamp(reduction, 0, depth - 2);
+}
+
+// Negamax search (returns only score, not move)
+template <NodeType nodeType>
+int negamax(SearchContext &ctx, Board &board, int depth, int alpha, int beta, int plyFromRoot)
+{
+    if (ctx.checkStop())
         return 0;
-    }
+    ctx.countNode();
+    ctx.pvLength[plyFromRoot] = plyFromRoot;
+    ctx.selDepth = std::max(ctx.selDepth, plyFromRoot);
+    if (plyFromRoot >= MAX_PLY - 1)
+        return evaluateBoard(board);
+
+    constexpr bool pvNode = nodeType == NodeType::PV;
+    const Move excludedMove = ctx.stack[plyFromRoot].excludedMove;
+
+    // Probe before generating moves; the bucket was prefetched by the parent.
+    // A singular search must not be answered by the entry it is verifying.
+    // PV nodes always search, so a table hit never cuts the reported PV short.
+    TTEntry ttEntry;
+    bool ttHit = ttProbe(board, ttEntry, plyFromRoot);
+    if (!pvNode && excludedMove == Move::NO_MOVE && ttHit && ttCutoff(TT, ttEntry, depth, alpha, beta))
+        return ttEntry.value;
 
     chess::Movelist legalMoves;
     movegen::legalmoves(legalMoves, board);
 
-    auto ttVal = ttLookup(board, depth, alpha, beta, plyFromRoot);
-    if (ttVal.has_value())
-        return ttVal.value().first;
-
     // Terminal detection
     if (board.isRepetition(1) || board.isInsufficientMaterial())
         return 0;
@@ -79,8 +282,33 @@ int negamax(Board &board, int depth, int alpha, int beta,
             return board.inCheck() ? -MATE_SCORE + plyFromRoot : 0;
     }
 
+    if (depth <= 0)
+        return quiesce(ctx, board, alpha, beta, plyFromRoot + 1);
+
+    // Static eval for the pruning decisions, reused from the TT when possible
+    const bool inCheck = board.inCheck();
+    int staticEval = TTEntry::EVAL_NONE;
+    if (!inCheck)
+        staticEval = (ttHit && ttEntry.eval != TTEntry::EVAL_NONE) ? ttEntry.eval
+                                                                    : evaluateBoard(board);
+
+    if (!pvNode && !inCheck && excludedMove == Move::NO_MOVE && std::abs(beta) < MATE_BOUND)
+    {
+        // Reverse futility: far enough above beta that no reply will bring us back
+        if (Pruning.reverseFutility && depth <= RFP_MAX_DEPTH && staticEval - RFP_MARGIN * depth >= beta)
+            return staticEval;
+
+        // Razoring: hopelessly below alpha, let quiescence confirm it
+        if (Pruning.razoring && depth <= RAZOR_MAX_DEPTH && staticEval + RAZOR_MARGIN * depth * depth < alpha)
+        {
+            int score = quiesce(ctx, board, alpha, alpha + 1, plyFromRoot + 1);
+            if (score <= alpha)
+                return score;
+        }
+    }
+
     // null move pruningp
-    if (depth >= 3 && !board.inCheck())
+    if (depth >= 3 && !inCheck && excludedMove == Move::NO_MOVE)
     {
         int nonPawnMaterial = 0;
         for (PieceType pt : {PieceType::KNIGHT, PieceType::BISHOP, PieceType::ROOK, PieceType::QUEEN})
@@ -90,35 +318,120 @@ int negamax(Board &board, int depth, int alpha, int beta,
         if (nonPawnMaterial >= 2 * MATERIAL_VALUES[(int)PieceType::ROOK])
         {
             board.makeNullMove();
-            int nullScore = -negamax(board, depth - 3, -beta, -beta + 1, start, timeLimit, plyFromRoot + 1, timedOut);
+            ctx.stack[plyFromRoot].currentMove = Move::NULL_MOVE;
+            ctx.stack[plyFromRoot].movedPiece = Piece::NONE;
+            int nullScore = -negamax<NodeType::NON_PV>(ctx, board, depth - 3, -beta, -beta + 1, plyFromRoot + 1);
             board.unmakeNullMove();
-            if (timedOut)
+            if (ctx.timedOut)
                 return 0;
             if (nullScore >= beta)
                 return beta;
         }
     }
 
-    if (depth <= 0)
-        return quiesce(board, alpha, beta, plyFromRoot + 1);
-
     int bestScore = INT_MIN;
     Move bestMove = Move::NULL_MOVE;
     int originalAlpha = alpha;
 
-    orderMovesInPlace(
-        board, legalMoves, plyFromRoot,
-        /*hashMove=*/std::nullopt,
-        std::vector<Move>{killerMoves[plyFromRoot][0], killerMoves[plyFromRoot][1]},
-        historyHeuristic);
-
-    for (auto move : legalMoves)
+    // Along the previous iteration's PV its move goes first, whatever the TT kept
+    Move ttMove = ttHit ? ttEntry.move : Move::NO_MOVE;
+    if (pvNode && ctx.previousPvMove(plyFromRoot) != Move::NO_MOVE)
+        ttMove = ctx.previousPvMove(plyFromRoot);
+    Move *counterMove = ctx.counterMoveSlot(plyFromRoot);
+    PieceToHistory *continuations[2] = {ctx.continuationHistory(plyFromRoot - 1),
+                                        ctx.continuationHistory(plyFromRoot - 2)};
+    MovePicker picker(board, legalMoves, ttMove, ctx.stack[plyFromRoot].killers,
+                      counterMove ? *counterMove : Move::NO_MOVE, &ctx.history, continuations);
+    // Moves searched before the cutoff, which the histories then penalize
+    Movelist quietsTried, capturesTried;
+
+    // ABDADA: moves another thread is already searching are put off until the picker runs dry
+    const bool abdada = Threads.abdada() && depth >= ThreadPool::ABDADA_DEFER_DEPTH;
+    chess::Movelist deferred;
+    int deferredIndex = 0;
+
+    // Quiet moves that cannot lift a hopeless node above alpha are skipped
+    const bool futile = Pruning.futility && !inCheck && depth <= FUTILITY_MAX_DEPTH &&
+                        std::abs(alpha) < MATE_BOUND &&
+                        staticEval + FUTILITY_MARGIN + FUTILITY_MARGIN_PER_PLY * depth <= alpha;
+    const int lmpMoveCount = (!pvNode && Pruning.lateMovePruning && !inCheck && depth <= LMP_MAX_DEPTH)
+                                 ? LMP_BASE + depth * depth
+                                 : INT_MAX;
+
+    const bool canExtend = plyFromRoot < std::min(2 * ctx.rootDepth, MAX_EXTENSION_PLY);
+    const bool singularCandidate = canExtend && depth >= SINGULAR_MIN_DEPTH && excludedMove == Move::NO_MOVE &&
+                                   ttHit && ttEntry.move == ttMove && ttEntry.flag != TTEntry::UPPERBOUND &&
+                                   ttEntry.depth >= depth - 3 && std::abs(ttEntry.value) < MATE_BOUND;
+    const Move previousMove = plyFromRoot > 0 ? ctx.stack[plyFromRoot - 1].currentMove : Move::NO_MOVE;
+
+    for (int i = 0;; ++i)
     {
+        Move move = picker.next();
+        const bool isDeferred = move == Move::NO_MOVE;
+        if (isDeferred)
+        {
+            if (deferredIndex == deferred.size())
+                break;
+            move = deferred[deferredIndex++];
+        }
+        // The excluded move does not count toward move numbers
+        if (move == excludedMove)
+        {
+            --i;
+            continue;
+        }
+        const bool capture = board.isCapture(move);
+        const bool quiet = !capture && move.typeOf() != Move::PROMOTION;
+        const bool givesCheck = board.givesCheck(move) != CheckType::NO_CHECK;
+        if (i > 0 && !isDeferred && quiet && !givesCheck && (futile || i >= lmpMoveCount))
+            continue;
+
+        uint64_t childKey = board.keyAfter(move);
+        if (abdada && i > 0 && !isDeferred && Threads.isSearching(childKey))
+        {
+            deferred.add(move);
+            continue;
+        }
+
+        // Singular extension: the TT move is the only one that holds the node up
+        int extension = 0;
+        if (singularCandidate && move == ttMove)
+        {
+            int singularBeta = ttEntry.value - SINGULAR_MARGIN_PER_PLY * depth;
+            ctx.stack[plyFromRoot].excludedMove = move;
+            int score = negamax<NodeType::NON_PV>(ctx, board, (depth - 1) / 2, singularBeta - 1, singularBeta, plyFromRoot);
+            ctx.stack[plyFromRoot].excludedMove = Move::NO_MOVE;
+            if (ctx.timedOut)
+                break;
+            if (score < singularBeta)
+                extension = 1;
+        }
+
+        // Checks that do not just give material away, and in PV nodes
+        // recaptures on the square the opponent just moved to
+        if (canExtend && extension == 0 &&
+            ((givesCheck && (pvNode || staticExchangeAtLeast(board, move, 0))) ||
+             (pvNode && capture && previousMove != Move::NULL_MOVE && previousMove != Move::NO_MOVE &&
+              move.to() == previousMove.to())))
+            extension = 1;
+
+        TT.prefetch(childKey);
+        if (abdada)
+            Threads.startSearching(childKey);
+        const Piece piece = board.at(move.from());
+        int reduction = quiet ? lateMoveReduction<nodeType>(ctx, move, i, depth, plyFromRoot, inCheck, givesCheck,
+                                                            ctx.history.quietScore(piece, move.to(), continuations))
+                              : 0;
+        ctx.stack[plyFromRoot].currentMove = move;
+        ctx.stack[plyFromRoot].movedPiece = piece;
         board.makeMove(move);
-        int score = -negamax(board, depth - 1, -beta, -alpha, start, timeLimit, plyFromRoot + 1, timedOut);
+        int score = searchMove<nodeType>(ctx, board, i, depth + extension, extension ? 0 : reduction, alpha, beta,
+                                         plyFromRoot);
         board.unmakeMove(move);
+        if (abdada)
+            Threads.finishSearching(childKey);
 
-        if (timedOut)
+        if (ctx.timedOut)
             break;
 
         if (score > bestScore)
@@ -127,41 +440,62 @@ int negamax(Board &board, int depth, int alpha, int beta,
             bestMove = move;
         }
         if (score > alpha)
+        {
             alpha = score;
+            if (pvNode)
+                ctx.updatePv(plyFromRoot, move);
+        }
         if (alpha >= beta)
         {
-            // Killer moves: only for non-captures
-            if (!board.isCapture(move))
+            const int bonus = History::bonus(depth);
+            if (!capture)
             {
-                if (killerMoves[plyFromRoot][0] != move)
+                Move *killers = ctx.stack[plyFromRoot].killers;
+                if (killers[0] != move)
                 {
-                    killerMoves[plyFromRoot][1] = killerMoves[plyFromRoot][0];
-                    killerMoves[plyFromRoot][0] = move;
+                    killers[1] = killers[0];
+                    killers[0] = move;
                 }
-                // History heuristic: only for quiet moves
-                historyHeuristic[move.from().index()][move.to().index()] += depth * depth;
+                if (counterMove)
+                    *counterMove = move;
+                ctx.history.updateQuiet(piece, move.to(), continuations, bonus);
+                for (const Move &tried : quietsTried)
+                    ctx.history.updateQuiet(board.at(tried.from()), tried.to(), continuations, -bonus);
             }
+            else
+                History::update(ctx.history.captureEntry(board, move), bonus);
+            // The captures tried first failed to refute the opponent's move
+            for (const Move &tried : capturesTried)
+                History::update(ctx.history.captureEntry(board, tried), -bonus);
             break;
         }
+        if (capture)
+            capturesTried.add(move);
+        else
+            quietsTried.add(move);
     }
 
-    ttStore(board, depth, bestMove, bestScore, originalAlpha, beta, plyFromRoot);
+    // An interrupted search has no trustworthy score to keep
+    if (ctx.timedOut)
+        return 0;
+    // Only the excluded move was left: it is singular
+    if (bestScore == INT_MIN)
+        return alpha;
+
+    if (excludedMove == Move::NO_MOVE)
+        ttStore(board, depth, bestMove, bestScore, originalAlpha, beta, plyFromRoot, staticEval);
 
     return bestScore;
 }
 
 // Negamax root: finds best move and score
-SearchResult negamaxRoot(Board &board, int depth, int alpha, int beta,
-                         std::chrono::steady_clock::time_point start, double timeLimit, int plyFromRoot, bool &timedOut)
+SearchResult negamaxRoot(SearchContext &ctx, Board &board, int depth, int alpha, int beta, int plyFromRoot)
 {
-    using namespace std::chrono;
-    if (timedOut)
+    if (ctx.checkStop())
         return {0, Move::NULL_MOVE};
-    if (duration<double>(steady_clock::now() - start).count() > timeLimit)
-    {
-        timedOut = true;
-        return {0, Move::NULL_MOVE};
-    }
+    ctx.countNode();
+    ctx.pvLength[plyFromRoot] = plyFromRoot;
+    ctx.rootDepth = depth;
 
     chess::Movelist legalMoves;
     movegen::legalmoves(legalMoves, board);
@@ -183,26 +517,33 @@ SearchResult negamaxRoot(Board &board, int depth, int alpha, int beta,
     Move bestMove = Move::NULL_MOVE;
     int originalAlpha = alpha;
 
-    orderMovesInPlace(
-        board, legalMoves, plyFromRoot,
-        /*hashMove=*/std::nullopt,
-        std::vector<Move>{killerMoves[plyFromRoot][0], killerMoves[plyFromRoot][1]},
-        historyHeuristic);
-
-    for (auto move : legalMoves)
+    // The previous iteration's best move goes first
+    TTEntry ttEntry;
+    Move ttMove = ctx.previousPvMove(plyFromRoot);
+    if (ttMove == Move::NO_MOVE && ttProbe(board, ttEntry, plyFromRoot))
+        ttMove = ttEntry.move;
+    PieceToHistory *const noContinuations[2] = {nullptr, nullptr};
+    MovePicker picker(board, legalMoves, ttMove, ctx.stack[plyFromRoot].killers, Move::NO_MOVE, &ctx.history,
+                      noContinuations);
+
+    Move move;
+    for (int i = 0; (move = picker.next()) != Move::NO_MOVE; ++i)
     {
+        TT.prefetch(board.keyAfter(move));
+        ctx.stack[plyFromRoot].currentMove = move;
+        ctx.stack[plyFromRoot].movedPiece = board.at(move.from());
         board.makeMove(move);
-        int score = -negamax(board, depth - 1, -beta, -alpha, start, timeLimit, plyFromRoot + 1, timedOut);
+        int score = searchMove<NodeType::PV>(ctx, board, i, depth, 0, alpha, beta, plyFromRoot);
         board.unmakeMove(move);
 
-        if (timedOut)
+        if (ctx.timedOut)
             break;
 
         if (score > bestScore || bestMove == Move::NULL_MOVE)
         {
             bestScore = score;
             bestMove = move;
-            std::cout << "info string Best move so far: " << uci::moveToUci(bestMove) << " with score " << bestScore << "\n";
+            ctx.updatePv(plyFromRoot, move);
         }
         if (score > alpha)
             alpha = score;
@@ -210,39 +551,78 @@ SearchResult negamaxRoot(Board &board, int depth, int alpha, int beta,
             break;
     }
 
-    ttStore(board, depth, bestMove, bestScore, originalAlpha, beta, plyFromRoot);
+    if (!ctx.timedOut)
+        ttStore(board, depth, bestMove, bestScore, originalAlpha, beta, plyFromRoot);
 
     return {bestScore, bestMove};
 }
 
-Move findBestMoveIterative(Board &board, int maxDepth, double totalTimeRemaining, double increment)
+// Helper thread: plain iterative deepening until the pool asks it to stop.
+// In Lazy SMP, odd helpers start one ply deeper so the threads desynchronize;
+// ABDADA keeps everyone on the same depth and splits work through the marks.
+void helperSearch(SearchContext &ctx, Board board, int maxDepth, size_t helperId)
 {
-    // Clear killer moves and history heuristic
-    for (int i = 0; i < MAX_PLY; ++i)
-    {
-        killerMoves[i][0] = Move::NULL_MOVE;
-        killerMoves[i][1] = Move::NULL_MOVE;
-    }
-    for (int i = 0; i < 64; ++i)
-        for (int j = 0; j < 64; ++j)
-            historyHeuristic[i][j] = 0;
+    ctx.clear();
+    ctx.timedOut = false;
+    ctx.clockPollCountdown = 0;
+    ctx.start = std::chrono::steady_clock::now();
+    ctx.timeLimit = 1e9;
+
+    int startDepth = Threads.smpMode() == SmpMode::LAZY_SMP ? 1 + int(helperId % 2) : 1;
+    for (int depth = startDepth; depth <= maxDepth && !ctx.timedOut; ++depth)
+        negamaxRoot(ctx, board, depth, -MATE_SCORE, MATE_SCORE, 0);
+}
 
-    TT.clear();
-    int moveNumber = board.fullMoveNumber();
-    chess::Movelist legalMoves;
-    movegen::legalmoves(legalMoves, board);
+void sendLine(const std::string &line)
+{
+    static std::mutex outputMutex;
+    std::lock_guard<std::mutex> lock(outputMutex);
+    std::cout << line << std::endl;
+}
 
-    int movesToGo = std::max(1, std::min(40, 60 - moveNumber));
-    double reserve = 1.0; // Always keep at least 1 second
-    double timeForMove = std::max(0.05, std::min(
-                                            (totalTimeRemaining - reserve) / movesToGo + 0.5 * increment,
-                                            0.5 * totalTimeRemaining)); // Never use more than 50% of remaining time
+// UCI score: centipawns, or full moves to mate, negative when getting mated
+static std::string uciScore(int score)
+{
+    if (std::abs(score) < MATE_BOUND)
+        return "cp " + std::to_string(score);
+    int movesToMate = (MATE_SCORE - std::abs(score) + 1) / 2;
+    return "mate " + std::to_string(score > 0 ? movesToMate : -movesToMate);
+}
+
+// Standard UCI report of a completed iteration. Nodes and nps add up the
+// work of every search thread.
+static void printInfo(const SearchContext &ctx, int depth, int score, std::chrono::steady_clock::time_point searchStart)
+{
+    using namespace std::chrono;
+    int64_t ms = duration_cast<milliseconds>(steady_clock::now() - searchStart).count();
+    uint64_t nodes = Threads.nodesSearched();
+    std::ostringstream line;
+    line << "info depth " << depth << " seldepth " << ctx.selDepth << " score " << uciScore(score) << " nodes "
+         << nodes << " nps " << nodes * 1000 / std::max<int64_t>(ms, 1) << " hashfull " << TT.hashfull()
+         << " time " << ms << " pv";
+    for (int i = 0; i < ctx.pvLength[0]; ++i)
+        line << " " << uci::moveToUci(ctx.pv[0][i]);
+    sendLine(line.str());
+}
 
-    auto start = std::chrono::steady_clock::now();
+Move iterativeDeepening(SearchContext &ctx, Board &board, int maxDepth, double timeLimit)
+{
+    // Forget killers and PVs; histories persist across moves
+    ctx.clear();
+    ctx.nodes = 0;
+    ctx.timedOut = false;
+    ctx.clockPollCountdown = 0;
+    ctx.start = std::chrono::steady_clock::now();
+    ctx.timeLimit = timeLimit;
+    // ctx.start moves while pondering; info times count from here
+    const auto searchStart = ctx.start;
 
+    chess::Movelist legalMoves;
+    movegen::legalmoves(legalMoves, board);
     if (legalMoves.empty())
     {
-        std::cout << "info string No legal moves available\n";
+        if (ctx.isMainThread)
+            sendLine("info string No legal moves available");
         return Move::NULL_MOVE;
     }
 
@@ -251,8 +631,9 @@ Move findBestMoveIterative(Board &board, int maxDepth, double totalTimeRemaining
 
     for (int depth = 1; depth <= maxDepth; ++depth)
     {
-        std::cout << "info string Searching at depth " << depth << "\n";
-        bool timedOut = false;
+        if (ctx.isMainThread)
+            sendLine("info string Searching at depth " + std::to_string(depth));
+        ctx.selDepth = 0;
 
         int window = 50; // centipawns
         int alpha = std::max(-MATE_SCORE, prevScore - window);
@@ -263,12 +644,13 @@ Move findBestMoveIterative(Board &board, int maxDepth, double totalTimeRemaining
         // Aspiration window loop
         while (true)
         {
-            result = negamaxRoot(board, depth, alpha, beta, start, timeForMove, 0, timedOut);
+            result = negamaxRoot(ctx, board, depth, alpha, beta, 0);
             move = result.bestMove;
 
-            if (timedOut)
+            if (ctx.timedOut)
             {
-                std::cout << "info string Search interrupted by time, keeping previous best move\n";
+                if (ctx.isMainThread)
+                    sendLine("info string Search interrupted by time, keeping previous best move");
                 break;
             }
 
@@ -278,7 +660,8 @@ Move findBestMoveIterative(Board &board, int maxDepth, double totalTimeRemaining
                 alpha = std::max(-MATE_SCORE, alpha - window);
                 beta = std::min(MATE_SCORE, beta);
                 window *= 2;
-                std::cout << "info string Aspiration window fail-low, widening window\n";
+                if (ctx.isMainThread)
+                    sendLine("info string Aspiration window fail-low, widening window");
                 continue;
             }
             else if (result.score >= beta)
@@ -287,7 +670,8 @@ Move findBestMoveIterative(Board &board, int maxDepth, double totalTimeRemaining
                 alpha = std::max(-MATE_SCORE, alpha);
                 beta = std::min(MATE_SCORE, beta + window);
                 window *= 2;
-                std::cout << "info string Aspiration window fail-high, widening window\n";
+                if (ctx.isMainThread)
+                    sendLine("info string Aspiration window fail-high, widening window");
                 continue;
             }
             else
@@ -299,30 +683,81 @@ Move findBestMoveIterative(Board &board, int maxDepth, double totalTimeRemaining
 
         prevScore = result.score;
 
-        if (!timedOut && std::find(legalMoves.begin(), legalMoves.end(), move) != legalMoves.end())
+        if (!ctx.timedOut && std::find(legalMoves.begin(), legalMoves.end(), move) != legalMoves.end())
         {
             bestMove = move;
-            std::cout << "info string Best move at depth " << depth << ": " << uci::moveToUci(bestMove) << "\n";
+            std::copy(ctx.pv[0], ctx.pv[0] + ctx.pvLength[0], ctx.previousPv);
+            ctx.previousPvLength = ctx.pvLength[0];
+            if (ctx.isMainThread)
+            {
+                sendLine("info string Best move at depth " + std::to_string(depth) + ": " + uci::moveToUci(bestMove));
+                printInfo(ctx, depth, result.score, searchStart);
+            }
         }
-        else if (timedOut)
+        else if (ctx.timedOut)
         {
-            std::cout << "info string Search interrupted by time, keeping previous best move\n";
+            if (ctx.isMainThread)
+                sendLine("info string Search interrupted by time, keeping previous best move");
             break;
         }
         else
         {
-            std::cout << "info string No legal moves found\n";
+            if (ctx.isMainThread)
+                sendLine("info string No legal moves found");
             break;
         }
 
         // Early exit if time is almost up
-        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
-        if (elapsed > 0.9 * timeForMove)
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - ctx.start).count();
+        if (elapsed > 0.9 * timeLimit)
         {
-            std::cout << "info string Stopping iterative deepening due to time\n";
+            if (ctx.isMainThread)
+                sendLine("info string Stopping iterative deepening due to time");
             break;
         }
     }
 
     return bestMove;
-}
\ No newline at end of file
+}
+
+Move findBestMoveIterative(Board &board, int maxDepth, double totalTimeRemaining, double increment)
+{
+    // The table survives across moves; older entries simply age out
+    TT.ensureReady();
+    TT.newSearch();
+    TT.stats.reset();
+
+    int moveNumber = board.fullMoveNumber();
+    int movesToGo = std::max(1, std::min(40, 60 - moveNumber));
+    double reserve = 1.0; // Always keep at least 1 second
+    double timeForMove = std::max(0.05, std::min(
+                                            (totalTimeRemaining - reserve) / movesToGo + 0.5 * increment,
+                                            0.5 * totalTimeRemaining)); // Never use more than 50% of remaining time
+
+    Threads.startHelpers(board, maxDepth);
+    Move bestMove = iterativeDeepening(Threads.mainContext(), board, maxDepth, timeForMove);
+    Threads.stopHelpers();
+
+#ifdef TT_STATS
+    sendLine("info string " + TT.stats.summary());
+#endif
+
+    return bestMove;
+}
+
+Move ponderMove(const SearchContext &ctx, Board &board, Move bestMove)
+{
+    if (bestMove == Move::NULL_MOVE || bestMove == Move::NO_MOVE)
+        return Move::NO_MOVE;
+    if (ctx.previousPvLength >= 2 && ctx.previousPv[0] == bestMove)
+        return ctx.previousPv[1];
+    board.makeMove(bestMove);
+    TTEntry entry;
+    Movelist replies;
+    movegen::legalmoves(replies, board);
+    Move reply = Move::NO_MOVE;
+    if (ttProbe(board, entry, 1) && std::find(replies.begin(), replies.end(), entry.move) != replies.end())
+        reply = entry.move;
+    board.unmakeMove(bestMove);
+    return reply;
+}
@@ -1,8 +1,12 @@
 #pragma once
 #include "chess.hpp"
+#include "history.hpp"
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 
 static const int MAX_DEPTH = 69;
+constexpr int MAX_PLY = 128;
 
 struct SearchResult
 {
@@ -10,12 +14,112 @@ struct SearchResult
     chess::Move bestMove;
 };
 
-SearchResult negamaxRoot(chess::Board &board, int depth, int alpha, int beta,
-                         std::chrono::steady_clock::time_point start, double timeLimit, int plyFromRoot, bool &timedOut);
+// What the search remembers about each ply of the current line
+struct SearchStackEntry
+{
+    chess::Move currentMove = chess::Move::NULL_MOVE;
+    chess::Piece movedPiece = chess::Piece::NONE;
+    chess::Move killers[2] = {chess::Move::NULL_MOVE, chess::Move::NULL_MOVE};
+    // Set while a singular extension search verifies the TT move here
+    chess::Move excludedMove = chess::Move::NO_MOVE;
+};
+
+// Everything a search thread writes to while searching. Contexts share
+// nothing but the transposition table, so independent searches can run
+// concurrently, each on its own context.
+struct SearchContext
+{
+    explicit SearchContext(bool isMainThread = true) : isMainThread(isMainThread) {}
+
+    // Forgets killers and PVs, e.g. before a new root search. The histories
+    // are kept for the whole game; history.clear() starts them over.
+    void clear();
+    // Latches timedOut once a stop was requested or, polled every
+    // CLOCK_POLL_NODES calls, the time limit is exceeded
+    bool checkStop();
+    // Countermove slot for the move played at plyFromRoot - 1, if there was one
+    chess::Move *counterMoveSlot(int plyFromRoot);
+    // Continuation table of the move played at plyFromRoot, null for a null
+    // move or before the root
+    PieceToHistory *continuationHistory(int plyFromRoot);
+    // Makes move followed by the child's line the PV at plyFromRoot
+    void updatePv(int plyFromRoot, chess::Move move);
+    // The previous iteration's move at plyFromRoot if the current line has
+    // followed that PV so far, else NO_MOVE
+    chess::Move previousPvMove(int plyFromRoot) const;
+    void countNode() { nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+    SearchStackEntry stack[MAX_PLY];
+    History history;
+    // Triangular PV table: pv[ply] holds the best line found from ply on
+    chess::Move pv[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY] = {};
+    // Line of the last completed iteration, searched first by the next one
+    chess::Move previousPv[MAX_PLY];
+    int previousPvLength = 0;
+    int selDepth = 0;
+    // Nominal depth of the current iteration, which bounds extensions
+    int rootDepth = 0;
+
+    // Only the owning thread writes it, so a relaxed load and store does
+    // without a locked add; the main thread sums every context's for info
+    std::atomic<uint64_t> nodes{0};
+    std::chrono::steady_clock::time_point start;
+    double timeLimit = 1e9;
+    bool timedOut = false;
+    // Reading the clock costs more than a node's worth of bookkeeping
+    static constexpr int CLOCK_POLL_NODES = 1024;
+    int clockPollCountdown = 0;
+    // May be set from any thread to end the search early
+    std::atomic<bool> stop{false};
+    // While set, e.g. during go ponder, the clock does not run: the time
+    // limit counts from when it is cleared (ponderhit)
+    std::atomic<bool> ponder{false};
+    // Helpers search silently
+    bool isMainThread;
+};
+
+SearchResult negamaxRoot(SearchContext &ctx, chess::Board &board, int depth, int alpha, int beta, int plyFromRoot);
+
+// Forward pruning switches, on by default; each can be turned off through
+// its UCI option to measure what it is worth
+struct PruningOptions
+{
+    bool reverseFutility = true;
+    bool futility = true;
+    bool razoring = true;
+    bool lateMovePruning = true;
+};
+
+extern PruningOptions Pruning;
+
+// PV nodes are searched with an open window and may end up on the principal
+// variation; everything else is a null-window search expected to fail
+enum class NodeType
+{
+    PV,
+    NON_PV
+};
+
+template <NodeType nodeType>
+int negamax(SearchContext &ctx, chess::Board &board, int depth, int alpha, int beta, int plyFromRoot);
+
+int quiesce(SearchContext &ctx, chess::Board &board, int alpha, int beta, int plyFromRoot);
+
+// Iterative deepening with aspiration windows on a single context
+chess::Move iterativeDeepening(SearchContext &ctx, chess::Board &board, int maxDepth, double timeLimit);
+
+// Full search for the engine: time allocation, TT aging and helper threads.
+// A stop requested on the main context before the call is honoured; the
+// caller clears it before starting the next search.
+chess::Move findBestMoveIterative(chess::Board &board, int maxDepth, double totalTimeRemaining, double increment = 0.0);
 
-int negamax(chess::Board &board, int depth, int alpha, int beta,
-            std::chrono::steady_clock::time_point start, double timeLimit, int plyFromRoot, bool &timedOut);
+// The reply the search expects to bestMove: the second PV move, else the TT
+// move after bestMove; NO_MOVE if unknown
+chess::Move ponderMove(const SearchContext &ctx, chess::Board &board, chess::Move bestMove);
 
-int quiesce(chess::Board &board, int alpha, int beta, int plyFromRoot);
+void helperSearch(SearchContext &ctx, chess::Board board, int maxDepth, size_t helperId);
 
-chess::Move findBestMoveIterative(chess::Board &board, int maxDepth, double totalTimeRemaining, double increment = 0.0);
\ No newline at end of file
+// Writes line plus a newline to stdout as one unit and flushes it. Both the
+// UCI loop and the search thread print, so their lines must not interleave.
+void sendLine(const std::string &line);
@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "chess.hpp"
+#include "movepick.hpp"
+#include "search.hpp"
+#include "threads.hpp"
+#include "tt.hpp"
+#include "utils.hpp"
+using namespace chess;
+
+static Move searchFen(SearchContext &ctx, const std::string &fen, int depth)
+{
+    Board board;
+    board.setFen(fen);
+    return iterativeDeepening(ctx, board, depth, 60.0);
+}
+
+bool testConcurrentContexts()
+{
+    // Two unrelated searches in one process, each on its own context
+    TT.clear();
+    SearchContext first(false), second(false);
+    Move firstMove, secondMove;
+    std::thread a([&]()
+                  { firstMove = searchFen(first, "kbK5/pp6/1P6/8/8/8/R7/8 w - - 0 2", 4); });
+    std::thread b([&]()
+                  { secondMove = searchFen(second, "8/1Q6/2PBK3/k7/8/2P2P2/8/7q w - - 7 63", 4); });
+    a.join();
+    b.join();
+
+    std::cout << "Got " << uci::moveToUci(firstMove) << " and " << uci::moveToUci(secondMove) << std::endl;
+    return uci::moveToUci(firstMove) == "a2a6" && uci::moveToUci(secondMove) == "d6c7" &&
+           first.nodes > 0 && second.nodes > 0;
+}
+
+bool testStopIsPerContext()
+{
+    TT.clear();
+    SearchContext stopped(false), running(false);
+    stopped.stop = true;
+    Move stoppedMove, runningMove;
+    std::thread a([&]()
+                  { stoppedMove = searchFen(stopped, "kbK5/pp6/1P6/8/8/8/R7/8 w - - 0 2", 6); });
+    std::thread b([&]()
+                  { runningMove = searchFen(running, "kbK5/pp6/1P6/8/8/8/R7/8 w - - 0 2", 4); });
+    a.join();
+    b.join();
+
+    // The stopped search falls back to the first legal move without searching
+    return stopped.timedOut && stopped.nodes == 0 && !running.timedOut && uci::moveToUci(runningMove) == "a2a6";
+}
+
+bool testRequestStop()
+{
+    // A search with an hour on the clock, two helpers, ended from the outside
+    TT.clear();
+    Threads.setCount(3);
+    Board board;
+    Move bestMove = Move::NO_MOVE;
+    std::thread search([&]()
+                       { bestMove = findBestMoveIterative(board, MAX_DEPTH, 3600.0); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    auto stopAt = std::chrono::steady_clock::now();
+    Threads.requestStop();
+    search.join();
+    double stopSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - stopAt).count();
+    Threads.setCount(1);
+    Threads.mainContext().stop = false;
+
+    Movelist legalMoves;
+    movegen::legalmoves(legalMoves, board);
+    std::cout << "Stopped after " << stopSeconds * 1000 << " ms" << std::endl;
+    return stopSeconds < 0.1 && std::find(legalMoves.begin(), legalMoves.end(), bestMove) != legalMoves.end();
+}
+
+bool testNodesNeverDecrease()
+{
+    // The second search's info lines must not count the first one's helper nodes
+    TT.clear();
+    Threads.setCount(4);
+    Board board;
+    // About half a second, which leaves the helpers with large counts
+    findBestMoveIterative(board, MAX_DEPTH, 20.0);
+    // Whether or not the helpers have woken yet, none may still count the last search
+    uint64_t leftover = Threads.nodesSearched() - Threads.mainContext().nodes;
+    Threads.startHelpers(board, 1);
+    bool resetOnStart = Threads.nodesSearched() - Threads.mainContext().nodes < leftover;
+    Threads.stopHelpers();
+    // A fresh table, so the helpers get to search long enough to be counted
+    TT.clear();
+    std::ostringstream output;
+    std::streambuf *stdoutBuffer = std::cout.rdbuf(output.rdbuf());
+    findBestMoveIterative(board, 8, 3600.0);
+    std::cout.rdbuf(stdoutBuffer);
+    Threads.setCount(1);
+
+    std::istringstream lines(output.str());
+    std::vector<uint64_t> reported;
+    for (std::string line; std::getline(lines, line);)
+    {
+        std::istringstream fields(line);
+        for (std::string field; fields >> field;)
+            if (field == "nodes")
+            {
+                uint64_t nodes = 0;
+                fields >> nodes;
+                reported.push_back(nodes);
+            }
+    }
+    std::cout << leftover << " helper nodes left over; reported";
+    for (uint64_t nodes : reported)
+        std::cout << " " << nodes;
+    std::cout << std::endl;
+    return resetOnStart && !reported.empty() && std::is_sorted(reported.begin(), reported.end());
+}
+
+bool testPonderHoldsClock()
+{
+    // 50 ms to think, but the clock only starts at ponderhit
+    TT.clear();
+    SearchContext ctx(false);
+    ctx.ponder = true;
+    std::atomic<bool> finished{false};
+    std::thread search([&]()
+                       {
+        Board board;
+        iterativeDeepening(ctx, board, MAX_DEPTH, 0.05);
+        finished = true; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    bool stillPondering = !finished;
+    auto hitAt = std::chrono::steady_clock::now();
+    ctx.ponder = false;
+    search.join();
+    double afterHit = std::chrono::duration<double>(std::chrono::steady_clock::now() - hitAt).count();
+    std::cout << "Finished " << afterHit * 1000 << " ms after ponderhit" << std::endl;
+    return stillPondering && afterHit < 0.5;
+}
+
+static bool seeAtLeast(const std::string &fen, const std::string &uciMove, int threshold)
+{
+    Board board;
+    board.setFen(fen);
+    return staticExchangeAtLeast(board, uci::uciToMove(board, uciMove), threshold);
+}
+
+bool testStaticExchange()
+{
+    struct Case
+    {
+        const char *fen, *move;
+        int threshold;
+        bool expected;
+    };
+    const Case cases[] = {
+        // Undefended pawn
+        {"1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "e1e5", 100, true},
+        {"1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "e1e5", 101, false},
+        // Knight for a pawn once the knight on d7 recaptures
+        {"1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1", "d3e5", 0, false},
+        // Queen takes a pawn defended by a pawn
+        {"4k3/8/3p4/4p3/8/8/8/4Q1K1 w - - 0 1", "e1e5", 0, false},
+        // The rook behind joins in after the first exchange
+        {"3r2k1/8/8/3p4/8/8/3R4/3R2K1 w - - 0 1", "d2d5", 100, true},
+        {"3r2k1/8/8/3p4/8/8/3R4/3R2K1 w - - 0 1", "d2d5", 101, false},
+        // The king recaptures, unless the square is still defended
+        {"8/8/3k4/3p4/4N3/8/8/4K3 w - - 0 1", "e4d5", 0, false},
+        {"8/8/3k4/3p4/4N3/8/3R4/4K3 w - - 0 1", "e4d5", 100, true},
+    };
+    for (const auto &c : cases)
+    {
+        if (seeAtLeast(c.fen, c.move, c.threshold) != c.expected)
+        {
+            std::cout << "SEE of " << c.move << " >= " << c.threshold << " wrong in " << c.fen << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool testMovePickerStages()
+{
+    // Rxa5 wins a knight, Qxe5 loses the queen for a pawn
+    Board board;
+    board.setFen("4k3/8/3p4/n3p3/8/8/3P4/R3Q1K1 w - - 0 1");
+    Movelist legalMoves;
+    movegen::legalmoves(legalMoves, board);
+
+    // The second killer is not even pseudo-legal here and must be skipped
+    const Move killers[2] = {uci::uciToMove(board, "g1h2"), Move::make<Move::NORMAL>(Square::SQ_H2, Square::SQ_H4)};
+    auto history = std::make_unique<History>();
+    history->main[Piece(PieceType::QUEEN, Color::WHITE)][Square(Square::SQ_F2).index()] = 500;
+    const PieceToHistory *const continuations[2] = {nullptr, nullptr};
+    MovePicker picker(board, legalMoves, uci::uciToMove(board, "d2d4"), killers, uci::uciToMove(board, "a1b1"),
+                      history.get(), continuations);
+
+    std::vector<std::string> picked;
+    for (Move move; (move = picker.next()) != Move::NO_MOVE;)
+        picked.push_back(uci::moveToUci(move));
+
+    // Every legal move exactly once
+    if (picked.size() != size_t(legalMoves.size()))
+        return false;
+    for (const Move &move : legalMoves)
+        if (std::count(picked.begin(), picked.end(), uci::moveToUci(move)) != 1)
+            return false;
+
+    const std::vector<std::string> expectedFirst = {"d2d4", "a1a5", "g1h2", "a1b1", "e1f2"};
+    return std::equal(expectedFirst.begin(), expectedFirst.end(), picked.begin()) && picked.back() == "e1e5";
+}
+
+bool testHistoryGravity()
+{
+    // Repeated maximal bonuses saturate below the bound instead of overflowing
+    int16_t entry = 0;
+    for (int i = 0; i < 1000; ++i)
+        History::update(entry, History::bonus(MAX_PLY));
+    if (entry <= 0 || entry > History::HISTORY_MAX)
+        return false;
+    for (int i = 0; i < 1000; ++i)
+        History::update(entry, -History::bonus(MAX_PLY));
+    if (entry >= 0 || entry < -History::HISTORY_MAX)
+        return false;
+
+    // A saturated entry still moves on the first opposite update
+    int16_t saturated = History::HISTORY_MAX;
+    History::update(saturated, -History::bonus(1));
+    return saturated < History::HISTORY_MAX - History::bonus(1);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 2)
+    {
+        std::string test = argv[1];
+        if (test == "testConcurrentContexts")
+            return testConcurrentContexts() ? 0 : 1;
+        if (test == "testStopIsPerContext")
+            return testStopIsPerContext() ? 0 : 1;
+        if (test == "testRequestStop")
+            return testRequestStop() ? 0 : 1;
+        if (test == "testNodesNeverDecrease")
+            return testNodesNeverDecrease() ? 0 : 1;
+        if (test == "testPonderHoldsClock")
+            return testPonderHoldsClock() ? 0 : 1;
+        if (test == "testStaticExchange")
+            return testStaticExchange() ? 0 : 1;
+        if (test == "testMovePickerStages")
+            return testMovePickerStages() ? 0 : 1;
+        if (test == "testHistoryGravity")
+            return testHistoryGravity() ? 0 : 1;
+        std::cout << "Unknown test: " << test << std::endl;
+        return 2;
+    }
+
+    int passed = 0, total = 8;
+
+    // Run all tests if no argument is given
+    if (testConcurrentContexts())
+    {
+        std::cout << "testConcurrentContexts passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testConcurrentContexts FAILED\n";
+
+    if (testStopIsPerContext())
+    {
+        std::cout << "testStopIsPerContext passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testStopIsPerContext FAILED\n";
+
+    if (testRequestStop())
+    {
+        std::cout << "testRequestStop passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testRequestStop FAILED\n";
+
+    if (testNodesNeverDecrease())
+    {
+        std::cout << "testNodesNeverDecrease passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testNodesNeverDecrease FAILED\n";
+
+    if (testPonderHoldsClock())
+    {
+        std::cout << "testPonderHoldsClock passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testPonderHoldsClock FAILED\n";
+
+    if (testStaticExchange())
+    {
+        std::cout << "testStaticExchange passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testStaticExchange FAILED\n";
+
+    if (testMovePickerStages())
+    {
+        std::cout << "testMovePickerStages passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testMovePickerStages FAILED\n";
+
+    if (testHistoryGravity())
+    {
+        std::cout << "testHistoryGravity passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testHistoryGravity FAILED\n";
+
+    std::cout << passed << "/" << total << " tests passed.\n";
+    return (passed == total) ? 0 : 1;
+}
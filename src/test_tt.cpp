@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <cstdio>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "chess.hpp"
+#include "eval.hpp"
+#include "tt.hpp"
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+using namespace chess;
+
+// Every field of an entry is derived from its key, so any mix of two
+// writes is detectable by the reader.
+static Move expectedMove(uint64_t key) { return Move(uint16_t(key & 0x0FFF)); }
+static int expectedValue(uint64_t key) { return int((key >> 12) % 20001) - 10000; }
+static int expectedDepth(uint64_t key) { return int((key >> 32) % 60) + 1; }
+static TTEntry::Flag expectedFlag(uint64_t key) { return TTEntry::Flag(1 + (key >> 40) % 3); }
+
+static uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+bool testStoreProbe()
+{
+    TranspositionTable tt(1);
+    tt.clear();
+    uint64_t key = 0x123456789ABCDEF0ULL;
+    tt.store(key, expectedDepth(key), expectedMove(key), expectedValue(key), expectedFlag(key));
+
+    TTEntry e;
+    if (!tt.probe(key, e))
+        return false;
+    if (tt.probe(key ^ 1, e))
+        return false;
+    tt.probe(key, e);
+    return e.move == expectedMove(key) && e.value == expectedValue(key) &&
+           e.depth == expectedDepth(key) && e.flag == expectedFlag(key);
+}
+
+bool testMateScoresRoundTrip()
+{
+    TranspositionTable tt(1);
+    tt.clear();
+    for (int dist : {0, 1, 7, 120, 999})
+    {
+        for (int sign : {1, -1})
+        {
+            uint64_t key = 0xABCDEF0000000000ULL + dist * 2 + (sign > 0);
+            int value = sign * (MATE_SCORE - dist);
+            tt.store(key, 5, Move::NO_MOVE, value, TTEntry::EXACT);
+            TTEntry e;
+            if (!tt.probe(key, e) || e.value != value)
+            {
+                std::cout << "Mate score " << value << " came back as " << e.value << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool testConcurrentStress()
+{
+    // A tiny table so that all threads fight over the same buckets
+    TranspositionTable tt(1);
+    tt.clear();
+    const int threadCount = std::max(4u, std::thread::hardware_concurrency());
+    const int opsPerThread = 2000000;
+    std::atomic<long> hits{0}, corrupt{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&, t]()
+                             {
+            std::mt19937_64 rng(t + 1);
+            long localHits = 0, localCorrupt = 0;
+            for (int i = 0; i < opsPerThread; ++i)
+            {
+                // Small key space: same keys are written and read by everyone
+                uint64_t key = splitmix64(rng() % 50000);
+                if (i & 1)
+                {
+                    tt.store(key, expectedDepth(key), expectedMove(key), expectedValue(key), expectedFlag(key));
+                    continue;
+                }
+                TTEntry e;
+                if (!tt.probe(key, e))
+                    continue;
+                ++localHits;
+                if (e.move != expectedMove(key) || e.value != expectedValue(key) ||
+                    e.depth != expectedDepth(key) || e.flag != expectedFlag(key))
+                    ++localCorrupt;
+            }
+            hits += localHits;
+            corrupt += localCorrupt; });
+    }
+    for (auto &th : threads)
+        th.join();
+
+    std::cout << threadCount << " threads, " << hits << " hits, " << corrupt << " corrupt entries" << std::endl;
+    return hits > 0 && corrupt == 0;
+}
+
+bool testSaveLoad()
+{
+    const std::string path = "test_tt_save_load.bin";
+    TranspositionTable saved(2);
+    // Nothing to save before the table was ever cleared
+    if (saved.save(path))
+        return false;
+    saved.clear();
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        uint64_t key = splitmix64(i);
+        saved.store(key, expectedDepth(key), expectedMove(key), expectedValue(key), expectedFlag(key));
+    }
+    if (!saved.save(path))
+        return false;
+
+    TranspositionTable loaded(1);
+    bool ok = loaded.load(path) && loaded.sizeMB() == 2;
+    for (uint64_t i = 0; ok && i < 1000; ++i)
+    {
+        uint64_t key = splitmix64(i);
+        TTEntry a, b;
+        bool inSaved = saved.probe(key, a);
+        ok = inSaved == loaded.probe(key, b) &&
+             (!inSaved || (a.move == b.move && a.value == b.value && a.depth == b.depth && a.flag == b.flag));
+    }
+    std::remove(path.c_str());
+    return ok;
+}
+
+bool testSharedMemoryTwoProcesses()
+{
+#if defined(__linux__) || defined(__APPLE__)
+    const std::string name = "/omble_test_tt_" + std::to_string(getpid());
+    TranspositionTable parent(1);
+    if (!parent.attachShared(name, 2))
+        return false;
+
+    // The child attaches to the existing segment, checks the parent's entry and adds its own
+    uint64_t parentKey = splitmix64(1), childKey = splitmix64(2);
+    parent.store(parentKey, expectedDepth(parentKey), expectedMove(parentKey), expectedValue(parentKey), expectedFlag(parentKey));
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        TranspositionTable child(1);
+        TTEntry e;
+        bool ok = child.attachShared(name, 1) && child.sizeMB() == 2 && child.probe(parentKey, e) &&
+                  e.value == expectedValue(parentKey);
+        child.store(childKey, expectedDepth(childKey), expectedMove(childKey), expectedValue(childKey), expectedFlag(childKey));
+        child.resize(1); // detach; _exit skips destructors
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    TTEntry e;
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 && parent.probe(childKey, e) &&
+              e.move == expectedMove(childKey) && e.value == expectedValue(childKey);
+
+    // Detaching the last user removes the segment
+    parent.resize(1);
+    int fd = shm_open(name.c_str(), O_RDONLY, 0600);
+    if (fd >= 0)
+    {
+        close(fd);
+        shm_unlink(name.c_str());
+        ok = false;
+    }
+    return ok;
+#else
+    return true;
+#endif
+}
+
+bool testStatsPerTable()
+{
+#ifdef TT_STATS
+    // Each table counts its own probes; the engine's TT is left alone
+    TT.stats.reset();
+    TranspositionTable tt(1);
+    tt.clear();
+    uint64_t key = splitmix64(3);
+    tt.store(key, 5, Move::NO_MOVE, 0, TTEntry::EXACT);
+    TTEntry e;
+    bool hit = tt.probe(key, e);
+    return hit && tt.stats.probes == 1 && tt.stats.hits == 1 && ttCutoff(tt, e, 0, -1, 1) &&
+           tt.stats.cutoffs == 1 && TT.stats.probes == 0 && TT.stats.hits == 0 && TT.stats.cutoffs == 0;
+#else
+    return true;
+#endif
+}
+
+static bool keyAfterMatches(Board &board, int depth)
+{
+    Movelist moves;
+    movegen::legalmoves(moves, board);
+    for (auto move : moves)
+    {
+        uint64_t predicted = board.keyAfter(move);
+        board.makeMove(move);
+        bool ok = predicted == board.hash() && (depth <= 1 || keyAfterMatches(board, depth - 1));
+        board.unmakeMove(move);
+        if (!ok)
+        {
+            std::cout << "keyAfter mismatch for " << uci::moveToUci(move) << " in " << board.getFen() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool testKeyAfter()
+{
+    // Castling, en passant, promotions and rook captures that remove castling rights
+    for (const char *fen : {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                            "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+                            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+                            "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"})
+    {
+        Board board;
+        board.setFen(fen);
+        if (!keyAfterMatches(board, 3))
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 2)
+    {
+        std::string test = argv[1];
+        if (test == "testStoreProbe")
+            return testStoreProbe() ? 0 : 1;
+        if (test == "testMateScoresRoundTrip")
+            return testMateScoresRoundTrip() ? 0 : 1;
+        if (test == "testConcurrentStress")
+            return testConcurrentStress() ? 0 : 1;
+        if (test == "testKeyAfter")
+            return testKeyAfter() ? 0 : 1;
+        if (test == "testSaveLoad")
+            return testSaveLoad() ? 0 : 1;
+        if (test == "testSharedMemoryTwoProcesses")
+            return testSharedMemoryTwoProcesses() ? 0 : 1;
+        if (test == "testStatsPerTable")
+            return testStatsPerTable() ? 0 : 1;
+        std::cout << "Unknown test: " << test << std::endl;
+        return 2;
+    }
+
+    int passed = 0, total = 7;
+
+    // Run all tests if no argument is given
+    if (testStoreProbe())
+    {
+        std::cout << "testStoreProbe passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testStoreProbe FAILED\n";
+
+    if (testMateScoresRoundTrip())
+    {
+        std::cout << "testMateScoresRoundTrip passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testMateScoresRoundTrip FAILED\n";
+
+    if (testConcurrentStress())
+    {
+        std::cout << "testConcurrentStress passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testConcurrentStress FAILED\n";
+
+    if (testKeyAfter())
+    {
+        std::cout << "testKeyAfter passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testKeyAfter FAILED\n";
+
+    if (testSaveLoad())
+    {
+        std::cout << "testSaveLoad passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testSaveLoad FAILED\n";
+
+    if (testSharedMemoryTwoProcesses())
+    {
+        std::cout << "testSharedMemoryTwoProcesses passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testSharedMemoryTwoProcesses FAILED\n";
+
+    if (testStatsPerTable())
+    {
+        std::cout << "testStatsPerTable passed\n";
+        ++passed;
+    }
+    else
+        std::cout << "testStatsPerTable FAILED\n";
+
+    std::cout << passed << "/" << total << " tests passed.\n";
+    return (passed == total) ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+#include "threads.hpp"
+#include "search.hpp"
+using namespace chess;
+
+ThreadPool Threads;
+
+void ThreadPool::setCount(size_t count)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+    }
+    wakeUp.notify_all();
+    for (auto &th : helpers)
+        th.join();
+    helpers.clear();
+    contexts.resize(1);
+
+    exiting = false;
+    for (size_t id = 1; id < std::max<size_t>(count, 1); ++id)
+    {
+        contexts.push_back(std::make_unique<SearchContext>(false));
+        helpers.emplace_back(&ThreadPool::idleLoop, this, id);
+    }
+}
+
+void ThreadPool::startHelpers(const Board &board, int maxDepth)
+{
+    if (helpers.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobBoard = board;
+        jobDepth = maxDepth;
+        for (size_t id = 1; id < contexts.size(); ++id)
+        {
+            contexts[id]->stop = false;
+            // Before any helper wakes, so info lines never add up the last search's nodes
+            contexts[id]->nodes = 0;
+        }
+        running = helpers.size();
+        ++jobId;
+    }
+    wakeUp.notify_all();
+}
+
+void ThreadPool::stopHelpers()
+{
+    for (size_t id = 1; id < contexts.size(); ++id)
+        contexts[id]->stop = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    allIdle.wait(lock, [&]()
+                 { return running == 0; });
+}
+
+void ThreadPool::requestStop()
+{
+    for (auto &ctx : contexts)
+        ctx->stop = true;
+}
+
+void ThreadPool::clearHistories()
+{
+    for (auto &ctx : contexts)
+        ctx->history.clear();
+}
+
+uint64_t ThreadPool::nodesSearched() const
+{
+    uint64_t total = 0;
+    for (const auto &ctx : contexts)
+        total += ctx->nodes.load(std::memory_order_relaxed);
+    return total;
+}
+
+void ThreadPool::idleLoop(size_t id)
+{
+    uint64_t lastJob = 0;
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        wakeUp.wait(lock, [&]()
+                    { return exiting || jobId != lastJob; });
+        if (exiting)
+            return;
+        lastJob = jobId;
+        Board board = jobBoard;
+        int maxDepth = jobDepth;
+        lock.unlock();
+
+        helperSearch(*contexts[id], board, maxDepth, id);
+
+        lock.lock();
+        if (--running == 0)
+            allIdle.notify_all();
+    }
+}
+
+bool ThreadPool::isSearching(uint64_t childKey) const
+{
+    for (const auto &slot : searching[childKey & (SEARCHING_SIZE - 1)])
+        if (slot.load(std::memory_order_relaxed) == childKey)
+            return true;
+    return false;
+}
+
+void ThreadPool::startSearching(uint64_t childKey)
+{
+    for (auto &slot : searching[childKey & (SEARCHING_SIZE - 1)])
+    {
+        uint64_t expected = 0;
+        if (slot.compare_exchange_strong(expected, childKey, std::memory_order_relaxed) || expected == childKey)
+            return;
+    }
+}
+
+void ThreadPool::finishSearching(uint64_t childKey)
+{
+    for (auto &slot : searching[childKey & (SEARCHING_SIZE - 1)])
+    {
+        uint64_t expected = childKey;
+        if (slot.compare_exchange_strong(expected, 0, std::memory_order_relaxed))
+            return;
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "chess.hpp"
+#include "search.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// How the helper threads cooperate
+enum class SmpMode
+{
+    LAZY_SMP, // shared hash only, helpers desynchronized by depth
+    ABDADA    // all threads on the same depth, deferring moves another thread is searching
+};
+
+// Persistent pool of search helper threads, reused across go commands.
+// The thread calling findBestMoveIterative is the main search thread; the
+// helpers search copies of the same position and share work through the
+// transposition table (and, in ABDADA mode, the currently-searching marks).
+// Every thread, the main one included, searches on its own SearchContext.
+class ThreadPool
+{
+public:
+    // Simplified ABDADA: below this depth moves are never deferred
+    static constexpr int ABDADA_DEFER_DEPTH = 3;
+
+    ThreadPool() { contexts.push_back(std::make_unique<SearchContext>(true)); }
+    ~ThreadPool() { setCount(1); }
+
+    // Total number of search threads, including the main one. Not to be
+    // called while a search is running.
+    void setCount(size_t count);
+    size_t count() const { return helpers.size() + 1; }
+    SearchContext &mainContext() { return *contexts[0]; }
+
+    // Wakes every helper on its own copy of board
+    void startHelpers(const chess::Board &board, int maxDepth);
+    // Asks the helpers to stop and waits until all of them are idle
+    void stopHelpers();
+    // Asks every search thread, the main one included, to stop as soon as
+    // it polls its flag. Safe to call from any thread, e.g. on UCI stop.
+    void requestStop();
+    // Forgets the move histories of every context, e.g. on ucinewgame. Not
+    // to be called while a search is running.
+    void clearHistories();
+    // Nodes searched so far by all threads in the current search
+    uint64_t nodesSearched() const;
+
+    // Not to be called while a search is running
+    void setMode(SmpMode newMode) { mode = newMode; }
+    SmpMode smpMode() const { return mode; }
+    bool abdada() const { return mode == SmpMode::ABDADA && !helpers.empty(); }
+
+    // ABDADA marks, keyed by the position a move leads to. Lock-free and
+    // approximate: a lost mark only costs some duplicated work.
+    bool isSearching(uint64_t childKey) const;
+    void startSearching(uint64_t childKey);
+    void finishSearching(uint64_t childKey);
+
+private:
+    void idleLoop(size_t id);
+
+    static constexpr size_t SEARCHING_SIZE = 32768;
+    static constexpr int SEARCHING_WAYS = 4;
+    std::atomic<uint64_t> searching[SEARCHING_SIZE][SEARCHING_WAYS] = {};
+    SmpMode mode = SmpMode::LAZY_SMP;
+
+    std::vector<std::thread> helpers;
+    // contexts[0] belongs to the main thread, contexts[id] to helper id
+    std::vector<std::unique_ptr<SearchContext>> contexts;
+    std::mutex mutex;
+    std::condition_variable wakeUp, allIdle;
+    bool exiting = false;
+    uint64_t jobId = 0;
+    size_t running = 0;
+    chess::Board jobBoard;
+    int jobDepth = 0;
+};
+
+extern ThreadPool Threads;
@@ -1,63 +1,444 @@
 #include "tt.hpp"
 #include "eval.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <chrono>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <vector>
 using namespace chess;
 
 // tt.cpp
-#include "tt.hpp"
-std::unordered_map<uint64_t, TTEntry> TT;
+TranspositionTable TT;
 
-// Zobrist key
-inline uint64_t boardKey(const Board &board)
+// Mate scores are squeezed into int16 above TT_MATE
+static constexpr int TT_MATE = 31000;
+
+static int16_t packValue(int value)
 {
-    return board.hash();
+    if (value > MATE_BOUND)
+        return int16_t(TT_MATE + (value - MATE_BOUND));
+    if (value < -MATE_BOUND)
+        return int16_t(-TT_MATE + (value + MATE_BOUND));
+    return int16_t(std::clamp(value, -TT_MATE, TT_MATE));
+}
+
+static int unpackValue(int16_t value)
+{
+    if (value > TT_MATE)
+        return MATE_BOUND + (value - TT_MATE);
+    if (value < -TT_MATE)
+        return -MATE_BOUND + (value + TT_MATE);
+    return value;
+}
+
+// Data word layout: move | value | eval | depth | generation+flag
+static constexpr int DEPTH_OFFSET = -7; // stored depth 0 marks an empty slot
+
+static uint64_t packData(Move move, int value, int eval, int depth, TTEntry::Flag flag, uint8_t generation)
+{
+    uint64_t depth8 = uint64_t(std::clamp(depth - DEPTH_OFFSET, 1, 255));
+    uint64_t eval16 = uint16_t(std::clamp(eval, TTEntry::EVAL_NONE, 32767));
+    return uint64_t(move.move()) | uint64_t(uint16_t(packValue(value))) << 16 | eval16 << 32 | depth8 << 48 |
+           uint64_t(uint8_t(generation << 2 | flag)) << 56;
+}
+
+static uint16_t dataMove(uint64_t data) { return uint16_t(data); }
+static int dataDepth8(uint64_t data) { return int((data >> 48) & 0xFF); }
+
+static void unpackData(uint64_t data, TTEntry &out)
+{
+    out.move = Move(dataMove(data));
+    out.value = unpackValue(int16_t(uint16_t(data >> 16)));
+    out.eval = int16_t(uint16_t(data >> 32));
+    out.depth = dataDepth8(data) + DEPTH_OFFSET;
+    out.flag = TTEntry::Flag((data >> 56) & 0x3);
+    out.generation = uint8_t(data >> 58);
+}
+
+// Largest power of two bucket count that fits, so the index is a mask
+static size_t bucketCountFor(size_t megabytes)
+{
+    megabytes = std::clamp<size_t>(megabytes, 1, TranspositionTable::MAX_MB);
+    size_t count = (megabytes << 20) / sizeof(TTBucket);
+    size_t pow2 = 1;
+    while (pow2 * 2 <= count)
+        pow2 *= 2;
+    return pow2;
+}
+
+void TranspositionTable::resize(size_t megabytes, bool explicitHugePages)
+{
+    size_t pow2 = bucketCountFor(megabytes);
+    detachShared();
+    buckets = nullptr;
+    if (!memory.allocate(pow2 * sizeof(TTBucket), explicitHugePages))
+        throw std::bad_alloc();
+    buckets = static_cast<TTBucket *>(memory.data());
+    bucketCount = pow2;
+    // The pages are left untouched until the next ensureReady()
+    clearPending = true;
+}
+
+void TranspositionTable::clear(size_t threadCount)
+{
+    // Each thread zeroes its own slice, which also faults its pages in.
+    // Constructing the buckets in place starts their lifetime after resize().
+    threadCount = std::clamp<size_t>(threadCount, 1, bucketCount);
+    size_t chunk = (bucketCount + threadCount - 1) / threadCount;
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < threadCount; ++t)
+    {
+        size_t first = std::min(bucketCount, t * chunk);
+        size_t last = std::min(bucketCount, first + chunk);
+        threads.emplace_back([this, first, last]()
+                             { std::uninitialized_value_construct(buckets + first, buckets + last); });
+    }
+    std::uninitialized_value_construct(buckets, buckets + std::min(bucketCount, chunk));
+    for (auto &th : threads)
+        th.join();
+    clearPending = false;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry &out) const
+{
+    TT_STAT(stats, probes);
+    bool bucketFull = true;
+    for (const auto &slot : bucketFor(key).slots)
+    {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.keyXorData.load(std::memory_order_relaxed);
+        if ((check ^ data) == key && dataDepth8(data) != 0)
+        {
+            TT_STAT(stats, hits);
+            unpackData(data, out);
+            return true;
+        }
+        bucketFull &= dataDepth8(data) != 0;
+    }
+    if (bucketFull)
+        TT_STAT(stats, collisions);
+    return false;
+}
+
+int TranspositionTable::hashfull() const
+{
+    int used = 0;
+    for (size_t i = 0; i < 1000 / TTBucket::ENTRIES; ++i)
+        for (const auto &slot : buckets[i].slots)
+        {
+            uint64_t data = slot.data.load(std::memory_order_relaxed);
+            used += dataDepth8(data) != 0 && (data >> 58) == generation8;
+        }
+    return used * 1000 / (1000 / TTBucket::ENTRIES * TTBucket::ENTRIES);
+}
+
+void TTStats::reset()
+{
+    for (auto *counter : {&probes, &hits, &cutoffs, &collisions, &overwrites, &rejects})
+        counter->store(0, std::memory_order_relaxed);
+}
+
+std::string TTStats::summary() const
+{
+    uint64_t p = probes.load(), h = hits.load();
+    std::ostringstream ss;
+    ss << "TT probes " << p << " hits " << h << " (" << (p ? 100.0 * h / p : 0.0) << "%)"
+       << " cutoffs " << cutoffs.load() << " collisions " << collisions.load()
+       << " overwrites " << overwrites.load() << " rejects " << rejects.load();
+    return ss.str();
+}
+
+// On-disk format: a page-sized header so the buckets can be mapped in place
+struct TTFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t bucketSize;
+    uint64_t bucketCount;
+    uint8_t generation;
+};
+
+static constexpr char TT_FILE_MAGIC[8] = "OMBLETT";
+static constexpr uint32_t TT_FILE_VERSION = 1;
+static constexpr size_t TT_FILE_HEADER_SIZE = 4096;
+
+// Shared memory layout: this header in the first page, then the buckets
+struct TTSharedHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t bucketSize;
+    uint64_t bucketCount;
+    std::atomic<uint32_t> ready;    // set by the creator once the buckets are zeroed
+    std::atomic<uint32_t> attached; // number of processes using the segment
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "lockless entries must also work across processes");
+
+bool TranspositionTable::save(const std::string &path) const
+{
+    // The buckets are uninitialized after resize(), or stale after ucinewgame
+    if (clearPending)
+    {
+        std::cout << "info string Hash not saved: a clear is pending, send isready first\n";
+        return false;
+    }
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    if (!f)
+    {
+        std::cout << "info string Could not write hash file: " << path << "\n";
+        return false;
+    }
+    char header[TT_FILE_HEADER_SIZE] = {};
+    TTFileHeader h = {};
+    std::memcpy(h.magic, TT_FILE_MAGIC, sizeof(h.magic));
+    h.version = TT_FILE_VERSION;
+    h.bucketSize = sizeof(TTBucket);
+    h.bucketCount = bucketCount;
+    h.generation = generation8;
+    std::memcpy(header, &h, sizeof(h));
+    f.write(header, sizeof(header));
+    f.write(reinterpret_cast<const char *>(buckets), std::streamsize(bucketCount * sizeof(TTBucket)));
+    if (!f)
+    {
+        std::cout << "info string Failed writing hash file: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool TranspositionTable::load(const std::string &path)
+{
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f)
+    {
+        std::cout << "info string Could not open hash file: " << path << "\n";
+        return false;
+    }
+    size_t fileSize = size_t(f.tellg());
+    f.seekg(0);
+    TTFileHeader h = {};
+    f.read(reinterpret_cast<char *>(&h), sizeof(h));
+    if (!f || std::memcmp(h.magic, TT_FILE_MAGIC, sizeof(h.magic)) != 0 || h.version != TT_FILE_VERSION ||
+        h.bucketSize != sizeof(TTBucket) || h.bucketCount == 0 || (h.bucketCount & (h.bucketCount - 1)) != 0 ||
+        fileSize != TT_FILE_HEADER_SIZE + h.bucketCount * sizeof(TTBucket))
+    {
+        std::cout << "info string Not a compatible hash file: " << path << "\n";
+        return false;
+    }
+
+    size_t bytes = h.bucketCount * sizeof(TTBucket);
+    detachShared();
+    buckets = nullptr;
+    if (!memory.mapFile(path, TT_FILE_HEADER_SIZE, bytes))
+    {
+        // No mmap on this platform: read it into regular memory
+        if (!memory.allocate(bytes, false))
+            throw std::bad_alloc();
+        f.seekg(TT_FILE_HEADER_SIZE);
+        f.read(static_cast<char *>(memory.data()), std::streamsize(bytes));
+    }
+    buckets = static_cast<TTBucket *>(memory.data());
+    bucketCount = h.bucketCount;
+    generation8 = h.generation & GENERATION_MASK;
+    clearPending = false;
+    return true;
+}
+
+// Retries when the segment opened turns out to be on its way out
+static constexpr int SHARED_ATTACH_ATTEMPTS = 1000;
+
+// Counts one more process in, unless the last user already left and is
+// unlinking the segment: a count that reached 0 never goes back up
+static bool joinShared(std::atomic<uint32_t> &attached)
+{
+    uint32_t users = attached.load();
+    while (users != 0)
+        if (attached.compare_exchange_weak(users, users + 1))
+            return true;
+    return false;
 }
 
-// Lookup
-std::optional<std::pair<int, Move>> ttLookup(const Board &board, int depth, int alpha, int beta, int plyFromRoot)
+bool TranspositionTable::attachShared(const std::string &name, size_t megabytes, size_t threadCount)
 {
-    auto key = boardKey(board);
-    auto it = TT.find(key);
-    if (it != TT.end())
+    size_t count = bucketCountFor(megabytes);
+    detachShared();
+    buckets = nullptr;
+
+    for (int attempt = 0;; ++attempt)
     {
-        const auto &e = it->second;
-        if (e.depth >= depth)
+        bool created = false;
+        if (attempt == SHARED_ATTACH_ATTEMPTS ||
+            !memory.mapShared(name, TT_FILE_HEADER_SIZE + count * sizeof(TTBucket), created))
         {
-            int val = e.value;
-            if (val > MATE_SCORE - 1000)
-                val -= plyFromRoot;
-            else if (val < -MATE_SCORE + 1000)
-                val += plyFromRoot;
-            if (e.flag == TTEntry::EXACT)
-                return std::make_pair(val, e.move);
-            else if (e.flag == TTEntry::LOWERBOUND && val > alpha)
-                alpha = val;
-            else if (e.flag == TTEntry::UPPERBOUND && val < beta)
-                beta = val;
-            if (alpha >= beta)
-                return std::make_pair(val, e.move);
+            std::cout << "info string Could not open shared memory segment " << name << "\n";
+            resize(megabytes);
+            return false;
         }
+        auto *h = static_cast<TTSharedHeader *>(memory.data());
+        auto *base = static_cast<char *>(memory.data()) + TT_FILE_HEADER_SIZE;
+
+        if (created)
+        {
+            std::memcpy(h->magic, TT_FILE_MAGIC, sizeof(h->magic));
+            h->version = TT_FILE_VERSION;
+            h->bucketSize = sizeof(TTBucket);
+            h->bucketCount = count;
+            new (&h->attached) std::atomic<uint32_t>(1);
+            buckets = reinterpret_cast<TTBucket *>(base);
+            bucketCount = count;
+            clear(threadCount);
+            // Publish only after the header and buckets are initialized
+            new (&h->ready) std::atomic<uint32_t>(0);
+            h->ready.store(1, std::memory_order_release);
+        }
+        else
+        {
+            // Another process is creating it: wait for it to publish, then check the layout
+            for (int i = 0; i < 10000 && h->ready.load(std::memory_order_acquire) == 0; ++i)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (h->ready.load(std::memory_order_acquire) == 0 || std::memcmp(h->magic, TT_FILE_MAGIC, sizeof(h->magic)) != 0 ||
+                h->version != TT_FILE_VERSION || h->bucketSize != sizeof(TTBucket) ||
+                memory.size() != TT_FILE_HEADER_SIZE + h->bucketCount * sizeof(TTBucket))
+            {
+                std::cout << "info string Incompatible shared memory segment " << name << "\n";
+                resize(megabytes);
+                return false;
+            }
+            if (!joinShared(h->attached))
+            {
+                // Opened just as the last user left: its name is being
+                // unlinked, so open or create the next segment instead
+                memory.release();
+                std::this_thread::yield();
+                continue;
+            }
+            buckets = reinterpret_cast<TTBucket *>(base);
+            bucketCount = h->bucketCount;
+            clearPending = false;
+        }
+        sharedName = name;
+        return true;
     }
-    return std::nullopt;
+}
+
+void TranspositionTable::detachShared()
+{
+    if (sharedName.empty())
+        return;
+    auto *h = static_cast<TTSharedHeader *>(memory.data());
+    if (h->attached.fetch_sub(1) == 1)
+        LargePageBuffer::unlinkShared(sharedName);
+    memory.release();
+    buckets = nullptr;
+    bucketCount = 0;
+    sharedName.clear();
+}
+
+// Replacement worth: deep entries are kept, entries from older searches age out
+int TranspositionTable::worth(uint64_t data) const
+{
+    int age = (generation8 - int(data >> 58)) & GENERATION_MASK;
+    return dataDepth8(data) - 8 * age;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, Move move, int value, TTEntry::Flag flag, int eval)
+{
+    TTBucket &bucket = bucketFor(key);
+
+    // Same position or an empty slot first, otherwise evict the least worthy entry
+    TTSlot *replace = &bucket.slots[0];
+    uint64_t replaceData = replace->data.load(std::memory_order_relaxed);
+    bool samePosition = false;
+    for (auto &slot : bucket.slots)
+    {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.keyXorData.load(std::memory_order_relaxed);
+        if (dataDepth8(data) == 0 || (check ^ data) == key)
+        {
+            replace = &slot;
+            replaceData = data;
+            samePosition = dataDepth8(data) != 0;
+            break;
+        }
+        if (worth(data) < worth(replaceData))
+        {
+            replace = &slot;
+            replaceData = data;
+        }
+    }
+
+    if (samePosition)
+    {
+        // Keep the old move if this search did not produce one
+        if (move == Move::NO_MOVE)
+            move = Move(dataMove(replaceData));
+        // Don't let a shallow bound of this search overwrite deeper work on the same position
+        bool fresh = (replaceData >> 58) == generation8;
+        if (fresh && flag != TTEntry::EXACT && depth - DEPTH_OFFSET + 3 < dataDepth8(replaceData))
+        {
+            TT_STAT(stats, rejects);
+            return;
+        }
+    }
+    else if (dataDepth8(replaceData) != 0)
+        TT_STAT(stats, overwrites);
+
+    uint64_t data = packData(move, value, eval, depth, flag, generation8);
+    replace->keyXorData.store(key ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
+}
+
+// Zobrist key
+inline uint64_t boardKey(const Board &board)
+{
+    return board.hash();
+}
+
+// Probe
+bool ttProbe(const Board &board, TTEntry &entry, int plyFromRoot)
+{
+    if (!TT.probe(boardKey(board), entry))
+        return false;
+    if (entry.value > MATE_SCORE - 1000)
+        entry.value -= plyFromRoot;
+    else if (entry.value < -MATE_SCORE + 1000)
+        entry.value += plyFromRoot;
+    return true;
+}
+
+bool ttCutoff(const TranspositionTable &table, const TTEntry &entry, int depth, int alpha, int beta)
+{
+    if (entry.depth < depth)
+        return false;
+    bool cutoff = entry.flag == TTEntry::EXACT ||
+                  (entry.flag == TTEntry::LOWERBOUND && entry.value >= beta) ||
+                  (entry.flag == TTEntry::UPPERBOUND && entry.value <= alpha);
+    if (cutoff)
+        TT_STAT(table.stats, cutoffs);
+    return cutoff;
 }
 
 // Store
-void ttStore(const Board &board, int depth, Move move, int value, int alpha, int beta, int plyFromRoot)
+void ttStore(const Board &board, int depth, Move move, int value, int alpha, int beta, int plyFromRoot, int staticEval)
 {
-    TTEntry entry;
-    entry.depth = depth;
-    // Normalize mate scores with ply distance
-    if (value > MATE_SCORE - 1000)
-        entry.value = value + plyFromRoot;
-    else if (value < -MATE_SCORE + 1000)
-        entry.value = value - plyFromRoot;
-    else
-        entry.value = value;
-    entry.move = move;
+    TTEntry::Flag flag;
     if (value <= alpha)
-        entry.flag = TTEntry::UPPERBOUND;
+        flag = TTEntry::UPPERBOUND;
     else if (value >= beta)
-        entry.flag = TTEntry::LOWERBOUND;
+        flag = TTEntry::LOWERBOUND;
     else
-        entry.flag = TTEntry::EXACT;
-    TT[boardKey(board)] = entry;
-}
\ No newline at end of file
+        flag = TTEntry::EXACT;
+    // Normalize mate scores with ply distance
+    if (value > MATE_SCORE - 1000)
+        value += plyFromRoot;
+    else if (value < -MATE_SCORE + 1000)
+        value -= plyFromRoot;
+    TT.store(boardKey(board), depth, move, value, flag, staticEval);
+}
@@ -1,22 +1,147 @@
 #pragma once
 #include "chess.hpp"
-#include <unordered_map>
+#include "largepages.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
 
+// Decoded transposition table entry, as returned by a probe
 struct TTEntry
 {
-    int depth;
-    int value;
-    chess::Move move;
-    enum Flag
+    enum Flag : uint8_t
     {
+        NONE,
         EXACT,
         LOWERBOUND,
         UPPERBOUND
-    } flag;
+    };
+
+    static constexpr int EVAL_NONE = -32768;
+
+    chess::Move move = chess::Move::NO_MOVE;
+    int value = 0; // mate scores relative to the node
+    int eval = EVAL_NONE;
+    int depth = 0;
+    Flag flag = NONE;
+    uint8_t generation = 0;
+};
+
+// Lockless slot: the key word holds key ^ data, so a slot torn by two
+// concurrent writers fails verification and reads as a miss.
+struct TTSlot
+{
+    std::atomic<uint64_t> keyXorData{0};
+    std::atomic<uint64_t> data{0};
+};
+
+// One cache line worth of slots, probed together
+struct alignas(64) TTBucket
+{
+    static constexpr int ENTRIES = 4;
+    TTSlot slots[ENTRIES];
+};
+
+static_assert(sizeof(TTBucket) == 64, "TTBucket must fill exactly one cache line");
+
+// Per-search counters, only updated when built with -DTT_STATS=ON
+struct TTStats
+{
+    std::atomic<uint64_t> probes{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> cutoffs{0};
+    std::atomic<uint64_t> collisions{0};  // misses in a bucket full of other positions
+    std::atomic<uint64_t> overwrites{0};  // stores that evicted another position
+    std::atomic<uint64_t> rejects{0};     // stores refused to protect deeper data
+
+    void reset();
+    std::string summary() const;
+};
+
+#ifdef TT_STATS
+#define TT_STAT(stats, counter) ((stats).counter.fetch_add(1, std::memory_order_relaxed))
+#else
+#define TT_STAT(stats, counter) ((void)0)
+#endif
+
+// Fixed-size, power-of-two bucketed hash table. probe() and store() may be
+// called from any number of threads without locking.
+class TranspositionTable
+{
+public:
+    static constexpr size_t DEFAULT_MB = 64;
+    static constexpr size_t MAX_MB = 65536;
+    static constexpr uint8_t GENERATION_MASK = 0x3F; // 6 bits next to the flag
+
+    explicit TranspositionTable(size_t megabytes = DEFAULT_MB) { resize(megabytes); }
+    ~TranspositionTable() { detachShared(); }
+
+    // Not thread-safe: no search may be running.
+    // resize() only reserves memory; the table must be cleared before use.
+    void resize(size_t megabytes, bool explicitHugePages = false);
+    // Zeroes the table and prefaults its pages, split across threadCount threads
+    void clear(size_t threadCount = 1);
+    // Defers clearing to the next ensureReady(), e.g. until the GUI sends isready.
+    // A shared table is never wiped on behalf of the other processes.
+    void scheduleClear() { clearPending |= sharedName.empty(); }
+    void ensureReady(size_t threadCount = 1)
+    {
+        if (clearPending)
+            clear(threadCount);
+    }
+    // Called once per root search; older entries become cheaper to evict
+    void newSearch() { generation8 = (generation8 + 1) & GENERATION_MASK; }
+
+    // Pull the bucket for key into cache ahead of a probe
+    void prefetch(uint64_t key) const
+    {
+#if defined(__GNUC__)
+        __builtin_prefetch(&bucketFor(key));
+#endif
+    }
+
+    bool probe(uint64_t key, TTEntry &out) const;
+    void store(uint64_t key, int depth, chess::Move move, int value, TTEntry::Flag flag,
+               int eval = TTEntry::EVAL_NONE);
+
+    // Dump to a file (header with size and format version, then the raw
+    // buckets) and warm-start from one by mapping it copy-on-write. Saving
+    // is refused while a clear is pending.
+    bool save(const std::string &path) const;
+    bool load(const std::string &path);
+
+    // Moves the table into the named POSIX shared memory segment, creating it
+    // with megabytes if no other process has. All attached processes probe and
+    // store into the same buckets; the last one to detach removes the segment.
+    bool attachShared(const std::string &name, size_t megabytes, size_t threadCount = 1);
+
+    size_t sizeMB() const { return bucketCount * sizeof(TTBucket) >> 20; }
+    // Permill of sampled slots written during the current search, for UCI hashfull
+    int hashfull() const;
+    LargePageMode pageMode() const { return memory.mode(); }
+
+    // This table's counters; see TT_STAT
+    mutable TTStats stats;
+
+private:
+    TTBucket &bucketFor(uint64_t key) const { return buckets[key & (bucketCount - 1)]; }
+    int worth(uint64_t data) const;
+    void detachShared();
+
+    LargePageBuffer memory;
+    TTBucket *buckets = nullptr;
+    size_t bucketCount = 0;
+    uint8_t generation8 = 0;
+    bool clearPending = true;
+    std::string sharedName;
 };
 
-extern std::unordered_map<uint64_t, TTEntry> TT;
+extern TranspositionTable TT;
 
-std::optional<std::pair<int, chess::Move>> ttLookup(const chess::Board &board, int depth, int alpha, int beta, int plyFromRoot);
-void ttStore(const chess::Board &board, int depth, chess::Move move, int value, int alpha, int beta, int plyFromRoot);
-uint64_t boardKey(const chess::Board &board);
\ No newline at end of file
+// Fills entry with everything stored for the position, mate scores adjusted to plyFromRoot
+bool ttProbe(const chess::Board &board, TTEntry &entry, int plyFromRoot);
+// Whether a probed entry is deep and tight enough to end the search of this node
+bool ttCutoff(const TranspositionTable &table, const TTEntry &entry, int depth, int alpha, int beta);
+void ttStore(const chess::Board &board, int depth, chess::Move move, int value, int alpha, int beta, int plyFromRoot,
+             int staticEval = TTEntry::EVAL_NONE);
+uint64_t boardKey(const chess::Board &board);
@@ -1,8 +1,6 @@
 #include "utils.hpp"
 #include "eval.hpp"
 #include <algorithm>
-#include <optional>
-#include <vector>
 
 using namespace chess;
 
@@ -66,95 +64,70 @@ int mvvLvaScore(const Board &board, const Move &move)
     return 10 * victim - attacker;
 }
 
-// Move ordering: hash move > captures (MVV-LVA) > killer moves > history > quiets
-std::vector<Move> orderMoves(
-    Board &board, Movelist &moves, int plyFromRoot,
-    const std::optional<Move> &hashMove,
-    const std::vector<Move> &killerMoves,
-    int historyHeuristic[64][64])
+// Every piece of either color attacking sq through occupied
+static Bitboard attackersTo(const Board &board, Square sq, Bitboard occupied)
 {
-    std::vector<std::pair<int, Move>> scoredMoves;
-
-    for (auto move : moves)
-    {
-        int score = 0;
+    Bitboard queens = board.pieces(PieceType::QUEEN);
+    return (attacks::pawn(Color::BLACK, sq) & board.pieces(PieceType::PAWN, Color::WHITE)) |
+           (attacks::pawn(Color::WHITE, sq) & board.pieces(PieceType::PAWN, Color::BLACK)) |
+           (attacks::knight(sq) & board.pieces(PieceType::KNIGHT)) |
+           (attacks::bishop(sq, occupied) & (board.pieces(PieceType::BISHOP) | queens)) |
+           (attacks::rook(sq, occupied) & (board.pieces(PieceType::ROOK) | queens)) |
+           (attacks::king(sq) & board.pieces(PieceType::KING));
+}
 
-        // 1. Hash move
-        if (hashMove && move == *hashMove)
-        {
-            score = 1000000;
-        }
-        // 2. Captures (MVV-LVA)
-        else if (board.isCapture(move))
-        {
-            score = 900000 + mvvLvaScore(board, move);
-        }
-        // 3. Killer moves
-        else if (std::find(killerMoves.begin(), killerMoves.end(), move) != killerMoves.end())
-        {
-            score = 800000;
-        }
-        // 4. History heuristic (optional)
-        else if (historyHeuristic)
-        {
-            int from = move.from().index();
-            int to = move.to().index();
-            score = 1000 + historyHeuristic[from][to];
-        }
-        else if (board.givesCheck(move) != CheckType::NO_CHECK)
-        {
-            score += 500;
-        }
-        // 5. Quiet moves
-        else
-        {
-            score = 0;
-        }
+bool staticExchangeAtLeast(const Board &board, Move move, int threshold)
+{
+    // Castling and promotions are left to the search
+    if (move.typeOf() == Move::CASTLING || move.typeOf() == Move::PROMOTION)
+        return 0 >= threshold;
 
-        scoredMoves.push_back({score, move});
-    }
+    Square from = move.from(), to = move.to();
+    bool enPassant = move.typeOf() == Move::ENPASSANT;
 
-    std::sort(scoredMoves.begin(), scoredMoves.end(),
-              [](const std::pair<int, Move> &a, const std::pair<int, Move> &b)
-              {
-                  return a.first > b.first;
-              });
+    // swap is what we are ahead after the last capture, relative to threshold,
+    // assuming the opponent may stop capturing
+    int swap = (enPassant ? MATERIAL_VALUES[0] : getPieceValue(board, to)) - threshold;
+    if (swap < 0)
+        return false;
+    swap = getPieceValue(board, from) - swap;
+    if (swap <= 0)
+        return true;
 
-    std::vector<Move> ordered;
-    for (auto &p : scoredMoves)
-        ordered.push_back(p.second);
+    Bitboard occupied = board.occ() ^ Bitboard::fromSquare(from) ^ Bitboard::fromSquare(to);
+    if (enPassant)
+        occupied ^= Bitboard::fromSquare(Square(to.index() ^ 8));
+    Bitboard diagonal = board.pieces(PieceType::BISHOP) | board.pieces(PieceType::QUEEN);
+    Bitboard straight = board.pieces(PieceType::ROOK) | board.pieces(PieceType::QUEEN);
+    Bitboard attackers = attackersTo(board, to, occupied);
+    Color side = board.sideToMove();
+    bool result = true;
 
-    return ordered;
-}
-
-void orderMovesInPlace(
-    Board &board, Movelist &moves, int plyFromRoot,
-    const std::optional<Move> &hashMove,
-    const std::vector<Move> &killerMoves,
-    int historyHeuristic[64][64])
-{
-    auto moveScore = [&](const Move &move) -> int
+    while (true)
     {
-        int score = 0;
-        if (hashMove && move == *hashMove)
-            score = 1000000;
-        else if (board.isCapture(move))
-            score = 900000 + mvvLvaScore(board, move);
-        else if ((!killerMoves.empty() && move == killerMoves[0]) ||
-                 (killerMoves.size() > 1 && move == killerMoves[1]))
-            score = 800000;
-        else if (historyHeuristic)
-            score = 1000 + historyHeuristic[move.from().index()][move.to().index()];
-        else if (board.givesCheck(move) != CheckType::NO_CHECK)
-            score += 500;
-        else
-            score = 0;
-        return score;
-    };
+        side = ~side;
+        attackers &= occupied;
+        Bitboard ours = attackers & board.us(side);
+        if (!ours)
+            break;
+        result = !result;
+
+        // Recapture with the least valuable piece, uncovering x-rays behind it
+        int pt = 0;
+        while (!(ours & board.pieces(ptArray[pt])))
+            ++pt;
+        if (ptArray[pt] == PieceType::KING)
+            // The king may only take last
+            return (attackers & board.them(side)) ? !result : result;
 
-    std::sort(moves.begin(), moves.end(),
-              [&](const Move &a, const Move &b)
-              {
-                  return moveScore(a) > moveScore(b);
-              });
-}
\ No newline at end of file
+        swap = MATERIAL_VALUES[pt] - swap;
+        if (swap < int(result))
+            break;
+        occupied ^= Bitboard::fromSquare((ours & board.pieces(ptArray[pt])).lsb());
+        if (ptArray[pt] == PieceType::PAWN || ptArray[pt] == PieceType::BISHOP || ptArray[pt] == PieceType::QUEEN)
+            attackers |= attacks::bishop(to, occupied) & diagonal;
+        if (ptArray[pt] == PieceType::ROOK || ptArray[pt] == PieceType::QUEEN)
+            attackers |= attacks::rook(to, occupied) & straight;
+    }
+    return result;
+}
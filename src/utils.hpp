@@ -1,6 +1,5 @@
 #pragma once
 #include "chess.hpp"
-#include <vector>
 
 static const int PAWN_PST[64] = {
     0, 0, 0, 0, 0, 0, 0, 0,
@@ -58,16 +57,10 @@ static const int KING_PST[64] = {
     20, 30, 10, 0, 0, 10, 30, 20};
 
 int getPieceValue(const chess::Board &board, chess::Square sq);
-// std::vector<chess::Move> orderMoves(chess::Board &board, chess::Movelist &moves, int plyFromRoot = 0);
-std::vector<chess::Move> orderMoves(
-    chess::Board &board, chess::Movelist &moves, int plyFromRoot,
-    const std::optional<chess::Move> &hashMove = std::nullopt,
-    const std::vector<chess::Move> &killerMoves = {},
-    int historyHeuristic[64][64] = nullptr);
-void orderMovesInPlace(
-    chess::Board &board, chess::Movelist &moves, int plyFromRoot,
-    const std::optional<chess::Move> &hashMove,
-    const std::vector<chess::Move> &killerMoves,
-    int historyHeuristic[64][64]);
+// Most valuable victim, least valuable attacker; 0 for non-captures
+int mvvLvaScore(const chess::Board &board, const chess::Move &move);
+// Static exchange evaluation: true if the capture sequence started by move on
+// its target square wins at least threshold centipawns for the side to move
+bool staticExchangeAtLeast(const chess::Board &board, chess::Move move, int threshold);
 int mirror(int idx);
 int countBits(chess::Bitboard bb);
\ No newline at end of file